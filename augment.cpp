@@ -0,0 +1,227 @@
+#include <Eigen/Core>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "audio.hpp"
+#include "augment.hpp"
+#include "extract.hpp"
+#include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
+#include "reduce.hpp"
+#include "stats.hpp"
+
+namespace fs = std::filesystem;
+
+struct Args {
+    bool reduce;
+    std::vector<fs::path> wav_files;
+    int copies;
+    uint64_t seed;
+    fs::path stem;
+    int dims = 0;
+    Encoding encoding = Encoding::kText;
+    bool has_encoding = false;
+    std::vector<fs::path> background_files;
+
+    const std::string USAGE =
+        "Usage: ./augment basis <wavs.txt> <copies> <seed> <basis-stem> "
+        "<encoding?> <backgrounds.txt?>\n"
+        "       ./augment reduce <wavs.txt> <copies> <seed> <basis-stem> "
+        "<dims> <encoding?> <backgrounds.txt?>";
+
+    Args(int argc, char* argv[]) {
+        std::string command = argc >= 2 ? argv[1] : "";
+        reduce = command == "reduce";
+        int required = reduce ? 7 : 6;
+        if ((command != "basis" && !reduce) || argc < required ||
+            argc > required + 2) {
+            std::cerr << USAGE << std::endl;
+            exit(2);
+        }
+
+        wav_files = ReadFileListing(argv[2]);
+        copies = std::stoi(argv[3]);
+        seed = std::stoull(argv[4]);
+        stem = argv[5];
+        if (reduce) {
+            dims = std::stoi(argv[6]);
+        }
+        if (argc >= required + 1) {
+            encoding = ParseEncoding(argv[required]);
+            has_encoding = true;
+        }
+        if (argc == required + 2) {
+            background_files = ReadFileListing(argv[required + 1]);
+        }
+
+        Validate();
+    }
+
+private:
+    void Validate() {
+        std::vector<std::string> extensions = {".stats", ".basis"};
+        if (reduce) extensions = {".basis", ".mean"};
+        for (const auto& ext : extensions) {
+            fs::path f = fs::path(stem).replace_extension(ext);
+            if (!fs::exists(f)) {
+                std::cerr << "Could not find file " << f << std::endl;
+                exit(2);
+            }
+        }
+
+        if (copies <= 0) {
+            std::cerr << "Copies (" << copies << ") must be positive."
+                      << std::endl;
+            exit(2);
+        }
+        if (reduce && dims <= 0) {
+            std::cerr << "Dimensions (" << dims << ") must be positive."
+                      << std::endl;
+            exit(2);
+        }
+    }
+};
+
+// Runs `process` on the flattened augmented features of each clip, one copy
+// per row, and hands its result to `write` in listing order. The features
+// are only ever held in memory.
+void ForEachAugmented(
+    const Args& args,
+    const std::function<Eigen::MatrixXd(Eigen::MatrixXd)>& process,
+    const std::function<void(const fs::path&, Eigen::MatrixXd)>& write) {
+    // The background pool is small and shared by every worker.
+    std::vector<Eigen::ArrayXd> backgrounds;
+    int background_rate = 0;
+    for (const auto& f : args.background_files) {
+        AudioFile aud(f.string());
+        if (background_rate != 0 && aud.sample_rate != background_rate) {
+            std::cerr << "Background clips must share one sample rate. " << f
+                      << " is " << aud.sample_rate << " Hz." << std::endl;
+            exit(1);
+        }
+        background_rate = aud.sample_rate;
+        backgrounds.push_back(std::move(aud.data));
+    }
+
+    AugmentOptions options;
+    options.seed = args.seed;
+    const Augmenter augmenter(options, std::move(backgrounds));
+
+    RunPipeline<std::pair<uint64_t, AudioFile>, Eigen::MatrixXd>(
+        args.wav_files,
+        [](const fs::path& f) {
+            // Keyed on the file name so each clip gets the same transforms
+            // wherever it is listed.
+            return std::make_pair(Fnv1a(f.filename().string()),
+                                  AudioFile(f.string()));
+        },
+        [&](std::pair<uint64_t, AudioFile> clip) {
+            const auto& [id, aud] = clip;
+            if (background_rate != 0 && aud.sample_rate != background_rate) {
+                throw std::runtime_error(
+                    "Clip is " + std::to_string(aud.sample_rate) +
+                    " Hz but the background clips are " +
+                    std::to_string(background_rate) + " Hz.");
+            }
+
+            thread_local ExtractorWorkspace workspace;
+            Eigen::MatrixXd features;
+            for (int k = 0; k < args.copies; k++) {
+                Eigen::ArrayXd augmented =
+                    augmenter.Apply(aud.data, aud.sample_rate, id, k);
+                Eigen::VectorXd feature = FlattenFeature(
+                    workspace.Extract(augmented, aud.sample_rate));
+                if (k == 0) features.resize(args.copies, feature.size());
+                features.row(k) = feature;
+            }
+            return process(std::move(features));
+        },
+        write);
+}
+
+// Folds the augmented features into the statistics saved by basis and
+// rewrites the basis, like basis --update. Keeps the encoding of the
+// existing basis unless told otherwise.
+void Basis(const Args& args) {
+    FeatureStats stats =
+        FeatureStats::Load(fs::path(args.stem).replace_extension(".stats"));
+    Encoding encoding =
+        args.has_encoding
+            ? args.encoding
+            : LoadQuantized(fs::path(args.stem).replace_extension(".basis"))
+                  .encoding;
+
+    ForEachAugmented(
+        args, [](Eigen::MatrixXd features) { return features; },
+        [&](const fs::path&, Eigen::MatrixXd features) {
+            if (features.cols() != stats.dims()) {
+                throw std::runtime_error(
+                    "Augmented features have " +
+                    std::to_string(features.cols()) +
+                    " dimensions but the statistics have " +
+                    std::to_string(stats.dims()) + ".");
+            }
+            stats.Add(features);
+        });
+
+    for (const auto& f : SaveBasis(args.stem, stats, encoding)) {
+        std::cout << f << std::endl;
+    }
+}
+
+// Projects the augmented features onto the basis as reduce does. All copies
+// of a clip go to one <stem>.aug.reduced, one copy per column, whose path is
+// printed so it can be appended to the reduced training listing.
+void Reduce(const Args& args) {
+    Eigen::VectorXd mean =
+        LoadMatrix(fs::path(args.stem).replace_extension(".mean"));
+    QuantizedMatrix basis =
+        LoadQuantized(fs::path(args.stem).replace_extension(".basis"));
+
+    ForEachAugmented(
+        args,
+        [&](Eigen::MatrixXd features) -> Eigen::MatrixXd {
+            if (features.cols() != mean.size()) {
+                throw std::runtime_error(
+                    "Augmented features have " +
+                    std::to_string(features.cols()) +
+                    " dimensions but the basis has " +
+                    std::to_string(mean.size()) + ".");
+            }
+
+            Eigen::MatrixXd reduced(args.dims, features.rows());
+            for (int k = 0; k < features.rows(); k++) {
+                Eigen::VectorXd r = basis.TransposeProduct(
+                    features.row(k).transpose() - mean,
+                    basis.cols() - args.dims, args.dims);
+
+                // Most important dimension first, as in reduce.
+                reduced.col(k) = r.reverse();
+            }
+            return reduced;
+        },
+        [&](const fs::path& f, Eigen::MatrixXd reduced) {
+            fs::path outfile = fs::path(f).replace_extension(".aug.reduced");
+            SaveMatrix(outfile, reduced, args.encoding);
+            std::cout << outfile << std::endl;
+        });
+}
+
+// Augmented features are computed on the fly and never written. `basis` adds
+// them to the statistics of the clean training features, and `reduce`
+// recomputes them once the basis exists and writes only their reduced
+// features. Both take the same copies and seed so they see the same audio.
+int main(int argc, char* argv[]) {
+    Args args(argc, argv);
+    if (args.reduce) {
+        Reduce(args);
+    } else {
+        Basis(args);
+    }
+    return 0;
+}
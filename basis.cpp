@@ -1,79 +1,113 @@
 #include <Eigen/Core>
-#include <Eigen/Eigenvalues>
 #include <filesystem>
 #include <iostream>
 #include <vector>
 
 #include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
 #include "reduce.hpp"
+#include "stats.hpp"
 
 namespace fs = std::filesystem;
 
+const std::string USAGE =
+    "Usage: ./basis <feats.txt> <encoding?>\n"
+    "       ./basis --update <basis-stem> <added.txt|-> <removed.txt|-> "
+    "<encoding?>";
+
+// Adds (or removes) every feature in the listing. Features are folded in a
+// block at a time so memory does not grow with the number of files.
+void Accumulate(FeatureStats& stats, const std::vector<fs::path>& files,
+                bool remove) {
+    const int kBlockSize = 256;
+    Eigen::MatrixXd block;
+    int filled = 0;
+
+    auto flush = [&] {
+        if (remove) {
+            stats.Remove(block.topRows(filled));
+        } else {
+            stats.Add(block.topRows(filled));
+        }
+        filled = 0;
+    };
+
+    RunPipeline<Eigen::VectorXd, Eigen::VectorXd>(
+        files,
+        [](const fs::path& f) -> Eigen::VectorXd {
+            return FlattenFeature(LoadMatrix(f));
+        },
+        [](Eigen::VectorXd feature) { return feature; },
+        [&](const fs::path&, Eigen::VectorXd feature) {
+            if (stats.dims() == 0 && stats.count() == 0) {
+                stats = FeatureStats(feature.size());
+            }
+            if (block.cols() != feature.size()) {
+                block.resize(kBlockSize, feature.size());
+            }
+
+            block.row(filled++) = feature;
+            if (filled == kBlockSize) flush();
+        });
+
+    if (filled > 0) flush();
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: ./basis <feats.txt>" << std::endl;
+    bool update = argc >= 2 && std::string(argv[1]) == "--update";
+    if (update ? (argc < 5 || argc > 6) : (argc < 2 || argc > 3)) {
+        std::cerr << USAGE << std::endl;
         exit(2);
     }
 
-    fs::path infile(argv[1]);
-    std::vector<fs::path> feature_files = ReadFileListing(infile);
-
     /***************************************************************
-        Load features
+        Accumulate statistics
     ***************************************************************/
+    fs::path stem;
+    Encoding encoding = Encoding::kText;
+    FeatureStats stats;
+
+    if (update) {
+        // Fold the changes into the statistics saved by a previous run.
+        stem = argv[2];
+        fs::path stats_file = fs::path(stem).replace_extension(".stats");
+        fs::path basis_file = fs::path(stem).replace_extension(".basis");
+        for (const auto& f : {stats_file, basis_file}) {
+            if (!fs::exists(f)) {
+                std::cerr << "Could not find file " << f << std::endl;
+                exit(2);
+            }
+        }
+        stats = FeatureStats::Load(stats_file);
 
-    // Could reduce memory overhead by reading files twice - once to calculate
-    // mean and again to compute covar by stacking XX^T. Accepting the memory
-    // to reduce time spent reading files.
-
-    // Rows = feature vec, col = dimensions
-    Eigen::MatrixXd features(feature_files.size(), 0);  // cols set later
-
-    for (int i = 0; i < feature_files.size(); i++) {
-        Eigen::ArrayXd feature = FlattenFeature(LoadCSV(feature_files[i]));
-
-        if (features.cols() == 0) {
-            features.conservativeResize(features.rows(), feature.size());
+        // Keep the encoding of the existing basis unless told otherwise.
+        if (argc == 6) {
+            encoding = ParseEncoding(argv[5]);
+        } else {
+            encoding = LoadQuantized(basis_file).encoding;
         }
 
-        assert(feature.size() == features.cols());
-        features.row(i) = feature;
+        if (std::string(argv[3]) != "-") {
+            Accumulate(stats, ReadFileListing(argv[3]), false);
+        }
+        if (std::string(argv[4]) != "-") {
+            Accumulate(stats, ReadFileListing(argv[4]), true);
+        }
+    } else {
+        stem = argv[1];
+        if (argc == 3) {
+            encoding = ParseEncoding(argv[2]);
+        }
+        Accumulate(stats, ReadFileListing(stem), false);
     }
 
-    Eigen::VectorXd mean = features.colwise().mean();
-    assert(mean.size() == features.cols());
-    features.rowwise() -= mean.transpose();
-
-    Eigen::MatrixXd covar = features.transpose() * features;
-    covar /= features.rows();  // normalization
-
-    // Assert symmetric and has intended dimensions
-    assert(covar.cols() == covar.rows());
-    assert(covar.cols() == mean.size());
-    assert((covar - covar.transpose())
-               .isApprox(Eigen::MatrixXd::Zero(covar.rows(), covar.cols())));
-
-    /***************************************************************
-        Eigenvalue decomposition
-    ***************************************************************/
-    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es;
-    es.compute(covar);
-
-    /***************************************************************
-        Save output
-    ***************************************************************/
-    fs::path scree_file = infile;
-    scree_file.replace_extension(".scree");
-    SaveCSV(scree_file, es.eigenvalues());
-    std::cout << scree_file << std::endl;
-
-    fs::path basis_file = infile;
-    basis_file.replace_extension(".basis");
-    SaveCSV(basis_file, es.eigenvectors());
-    std::cout << basis_file << std::endl;
+    if (stats.count() < 1) {
+        std::cerr << "No features to compute a basis from." << std::endl;
+        exit(1);
+    }
 
-    fs::path mean_file = infile;
-    mean_file.replace_extension(".mean");
-    SaveCSV(mean_file, mean);
-    std::cout << mean_file << std::endl;
+    for (const auto& f : SaveBasis(stem, stats, encoding)) {
+        std::cout << f << std::endl;
+    }
 }
@@ -0,0 +1,118 @@
+# Times every stage of the pipeline on a synthetic corpus at increasing thread
+# counts, to find where scaling stops before a full size run does.
+
+# Usage: bash bench.sh <wavs.txt> <clips> [seconds] [sample-rate]
+# Where <wavs.txt> lists the recordings to perturb, e.g.
+#   printf '%s\n' free-spoken-digit-dataset/recordings/*.wav > recordings.txt
+# The corpus is generated once by `synth` into bench/<clips>, then pipeline.sh's
+# stages are run against it at 1, 2, 4 ... nproc threads. Set THREADS to a list
+# of thread counts to override them. Prints one CSV row per stage:
+#   threads,stage,clips,wall_sec,clips_per_sec,peak_rss_kb
+# which is also saved to bench/<clips>/bench.csv. Peak RSS needs GNU time at
+# /usr/bin/time and is NA without it.
+#
+# classify-train is libsvm's single-threaded solver, whose cost grows faster
+# than linearly with the number of clips. It is run once rather than per thread
+# count, on every k-th training clip so that at most SVM_CLIPS (default 20000)
+# are used, and its row is reported with 1 thread. Every thread count predicts
+# with that model.
+
+wavs=$1
+clips=$2
+seconds=${3:-1}
+rate=${4:-8000}
+
+if [ -z "$clips" ]; then
+    echo "Usage: bash bench.sh <wavs.txt> <clips> [seconds] [sample-rate]"
+    exit 2
+fi
+
+dimensions=12
+corpus=bench/$clips
+svm_clips=${SVM_CLIPS:-20000}
+
+if [ -z "$THREADS" ]; then
+    THREADS=""
+    for ((t = 1; t < $(nproc); t *= 2)); do
+        THREADS="$THREADS $t"
+    done
+    THREADS="$THREADS $(nproc)"
+fi
+
+gnu_time=""
+if /usr/bin/time -f %M true > /dev/null 2>&1; then
+    gnu_time=/usr/bin/time
+fi
+
+if [ ! -d "$corpus/train_data" ]; then
+    echo "Generating $clips clips in $corpus." >&2
+    ./build/synth $wavs $corpus $clips $seconds $rate > /dev/null || exit 1
+fi
+
+printf '%s\n' $corpus/train_data/*.wav > $corpus/train_wav.txt
+printf '%s\n' $corpus/test_data/*.wav > $corpus/test_wav.txt
+train_clips=$(wc -l < $corpus/train_wav.txt)
+test_clips=$(wc -l < $corpus/test_wav.txt)
+
+# Usage: stage <name> <clips> <stdout file> <command...>
+stage() {
+    local name=$1 count=$2 out=$3
+    shift 3
+
+    local start=$(date +%s.%N)
+    local rss=NA
+    if [ -n "$gnu_time" ]; then
+        $gnu_time -f %M -o $work/rss "$@" >> $out || exit 1
+        rss=$(tail -n 1 $work/rss)
+    else
+        "$@" >> $out || exit 1
+    fi
+    local end=$(date +%s.%N)
+
+    awk -v t=$threads -v s=$name -v n=$count -v a=$start -v b=$end -v r=$rss \
+        'BEGIN { printf "%d,%s,%d,%.3f,%.1f,%s\n", t, s, n, b - a, n / (b - a), r }' |
+        tee -a $corpus/bench.csv
+}
+
+# Usage: train_once
+# Trains $corpus/model on a subsample of $work/train.reduced, if not done yet.
+train_once() {
+    [ -f $corpus/model ] && return
+
+    local stride=$(( (train_clips + svm_clips - 1) / svm_clips ))
+    awk -v k=$stride 'k == 1 || NR % k == 1' $work/train.reduced > $corpus/svm_train.reduced
+    local count=$(wc -l < $corpus/svm_train.reduced)
+    echo "Training the SVM once on $count of $train_clips clips (SVM_CLIPS=$svm_clips)." >&2
+
+    local sweep_threads=$threads
+    local start=$(date +%s.%N)
+    threads=1
+    stage classify-train $count /dev/null ./build/classify train $corpus/svm_train.reduced $corpus/model
+    threads=$sweep_threads
+    train_sec=$(awk -v a=$start -v b=$(date +%s.%N) 'BEGIN { print b - a }')
+}
+
+rm -f $corpus/model
+echo "threads,stage,clips,wall_sec,clips_per_sec,peak_rss_kb" | tee $corpus/bench.csv
+for threads in $THREADS; do
+    export PROJ748_THREADS=$threads
+    work=$corpus/t$threads
+    rm -rf $work
+    mkdir -p $work
+
+    train_sec=0
+    start=$(date +%s.%N)
+    stage extract-train $train_clips $work/train.txt ./build/extract $corpus/train_wav.txt
+    stage basis $train_clips /dev/null ./build/basis $work/train.txt
+    stage reduce-train $train_clips $work/train.reduced ./build/reduce $work/train.txt $work/train $dimensions
+    train_once
+    stage extract-test $test_clips $work/test.txt ./build/extract $corpus/test_wav.txt
+    stage reduce-test $test_clips $work/test.reduced ./build/reduce $work/test.txt $work/train $dimensions
+    stage classify-predict $test_clips /dev/null ./build/classify predict $work/test.reduced $corpus/model $work/confusion.txt
+    end=$(date +%s.%N)
+
+    # The total leaves out the one-off training.
+    awk -v t=$threads -v n=$((train_clips + test_clips)) -v a=$start -v b=$end -v x=$train_sec \
+        'BEGIN { printf "%d,total,%d,%.3f,%.1f,NA\n", t, n, b - a - x, n / (b - a - x) }' |
+        tee -a $corpus/bench.csv
+done
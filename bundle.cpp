@@ -0,0 +1,84 @@
+#include "bundle.hpp"
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <iostream>
+
+#include "classify.hpp"
+#include "extract.hpp"
+#include "quantize.hpp"
+
+namespace fs = std::filesystem;
+
+struct Args {
+    fs::path basis_file;
+    fs::path mean_file;
+    int dims;
+    fs::path model_file;
+    int sample_rate;
+    fs::path bundle_file;
+
+    const std::string USAGE =
+        "Usage: ./bundle <basis-stem> <dims> <model> <sample-rate> "
+        "<out.bundle>";
+
+    Args(int argc, char* argv[]) {
+        if (argc != 6) {
+            std::cerr << USAGE << std::endl;
+            exit(2);
+        }
+
+        basis_file = fs::path(argv[1]).replace_extension(".basis");
+        mean_file = fs::path(argv[1]).replace_extension(".mean");
+        dims = std::stoi(argv[2]);
+        model_file = argv[3];
+        sample_rate = std::stoi(argv[4]);
+        bundle_file = argv[5];
+
+        Validate();
+    }
+
+private:
+    void Validate() {
+        for (const auto& f : {basis_file, mean_file, model_file}) {
+            if (!fs::exists(f)) {
+                std::cerr << "Could not find file " << f << std::endl;
+                exit(2);
+            }
+        }
+
+        if (dims <= 0) {
+            std::cerr << "Dimensions (" << dims << ") must be positive."
+                      << std::endl;
+            exit(2);
+        }
+        if (sample_rate <= 0) {
+            std::cerr << "Sample rate (" << sample_rate
+                      << ") must be positive." << std::endl;
+            exit(2);
+        }
+    }
+};
+
+// Packs a trained model into one file for `infer`. The basis and model must
+// come from the same `reduce` dimensions, and the filterbank is built for
+// clips at `sample-rate`.
+int main(int argc, char* argv[]) {
+    Args args(argc, argv);
+
+    Eigen::MatrixXd basis = LoadMatrix(args.basis_file).matrix();
+    Eigen::VectorXd mean = LoadMatrix(args.mean_file);
+    SvmModel model = SvmModel::Load(args.model_file);
+
+    if (basis.rows() != FeatureConfig().num_filters *
+                            FeatureConfig().num_periods) {
+        std::cerr << args.basis_file << " was not computed from features "
+                  << "with the default extractor settings." << std::endl;
+        exit(1);
+    }
+
+    ModelBundle::Save(args.bundle_file, FeatureConfig(), args.sample_rate,
+                      basis, mean, args.dims, model);
+    std::cout << args.bundle_file << std::endl;
+    return 0;
+}
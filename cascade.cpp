@@ -0,0 +1,198 @@
+#include <Eigen/Core>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cascade.hpp"
+#include "classify.hpp"
+#include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
+#include "reduce.hpp"
+
+namespace fs = std::filesystem;
+
+const std::string USAGE =
+    "Usage: ./cascade train <reduced.txt> <cascade-stem> <dims,dims,...>\n"
+    "       ./cascade predict <feats.txt> <basis-stem> <cascade-stem> "
+    "<predictions.txt>";
+
+std::vector<int> ParseDims(const std::string& list) {
+    std::vector<int> dims;
+    std::stringstream ss(list);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        dims.push_back(std::stoi(token));
+    }
+    return dims;
+}
+
+void Train(const fs::path& listing, const fs::path& stem,
+           const std::vector<int>& dims) {
+    LabelledSamples samples = LoadLabelledSamples(listing);
+    if (samples.labels.empty()) {
+        std::cerr << "No samples in " << listing << std::endl;
+        exit(1);
+    }
+
+    Cascade cascade = Cascade::Train(samples.features, samples.labels, dims);
+    cascade.Save(stem);
+
+    const auto& stages = cascade.stages();
+    for (int k = 0; k + 1 < stages.size(); k++) {
+        std::cout << "Stage " << k << " (" << stages[k].dims
+                  << " dims) exits at margin " << stages[k].threshold
+                  << std::endl;
+    }
+}
+
+struct Outcome {
+    int label;
+    Cascade::Prediction cascade;
+    std::vector<double> stage_seconds;
+    double cascade_sec;
+
+    // The last stage on its own, for comparison.
+    int full_label;
+    double full_sec;
+};
+
+void Predict(const fs::path& listing, const fs::path& basis_stem,
+             const fs::path& stem, const fs::path& predictions_file) {
+    for (const auto& ext : {".basis", ".mean"}) {
+        fs::path f = fs::path(basis_stem).replace_extension(ext);
+        if (!fs::exists(f)) {
+            std::cerr << "Could not find file " << f << std::endl;
+            exit(2);
+        }
+    }
+
+    Eigen::VectorXd mean =
+        LoadMatrix(fs::path(basis_stem).replace_extension(".mean"));
+    QuantizedMatrix basis =
+        LoadQuantized(fs::path(basis_stem).replace_extension(".basis"));
+    Cascade cascade = Cascade::Load(stem);
+    const auto& stages = cascade.stages();
+
+    std::ofstream out(predictions_file);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << predictions_file << std::endl;
+        exit(1);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<Outcome> outcomes;
+
+    RunPipeline<std::pair<int, Eigen::VectorXd>, Outcome>(
+        ReadFileListing(listing),
+        [&](const fs::path& f) {
+            // assume the label is the first character
+            int label = f.stem().string()[0] - '0';
+            Eigen::VectorXd feature = FlattenFeature(LoadMatrix(f));
+            return std::make_pair(label, Eigen::VectorXd(feature - mean));
+        },
+        [&](std::pair<int, Eigen::VectorXd> sample) {
+            const auto& [label, centered] = sample;
+            Outcome o;
+            o.label = label;
+
+            auto start = Clock::now();
+            o.cascade = cascade.Predict(centered, basis, &o.stage_seconds);
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+            o.cascade_sec = elapsed.count();
+
+            const int dims = stages.back().dims;
+            start = Clock::now();
+            Eigen::VectorXd reduced = basis.TransposeProduct(
+                centered, basis.cols() - dims, dims);
+            reduced.reverseInPlace();
+            o.full_label = stages.back().model.Predict(reduced);
+            elapsed = Clock::now() - start;
+            o.full_sec = elapsed.count();
+            return o;
+        },
+        [&](const fs::path&, Outcome o) {
+            out << o.cascade.label << "\n";
+            outcomes.push_back(std::move(o));
+        });
+
+    if (outcomes.empty()) {
+        std::cerr << "No samples in " << listing << std::endl;
+        exit(1);
+    }
+
+    /***************************************************************
+        Report
+    ***************************************************************/
+    const int n = outcomes.size();
+    double full_sec = 0;
+    int full_correct = 0;
+    for (const auto& o : outcomes) {
+        full_sec += o.full_sec;
+        full_correct += o.full_label == o.label;
+    }
+    double full_mean_us = 1e6 * full_sec / n;
+
+    // Latency of a stage is the mean over the samples that reached it. Saved
+    // latency compares the samples exiting at a stage with running the last
+    // stage alone.
+    std::cout << "stage,dims,exit_fraction,accuracy,stage_latency_us,"
+              << "exit_latency_us,saved_us" << std::endl;
+
+    int cascade_correct = 0;
+    double cascade_sec = 0;
+    for (int k = 0; k < stages.size(); k++) {
+        int reached = 0;
+        int exited = 0;
+        int correct = 0;
+        double stage_sec = 0;
+        double exit_sec = 0;
+        for (const auto& o : outcomes) {
+            if (o.cascade.stage < k) continue;
+            reached++;
+            stage_sec += o.stage_seconds[k];
+            if (o.cascade.stage != k) continue;
+            exited++;
+            exit_sec += o.cascade_sec;
+            correct += o.cascade.label == o.label;
+        }
+        cascade_correct += correct;
+        cascade_sec += exit_sec;
+
+        double exit_us = exited ? 1e6 * exit_sec / exited : 0;
+        std::cout << k << "," << stages[k].dims << ","
+                  << static_cast<double>(exited) / n << ","
+                  << (exited ? static_cast<double>(correct) / exited : 0)
+                  << "," << (reached ? 1e6 * stage_sec / reached : 0) << ","
+                  << exit_us << "," << (exited ? full_mean_us - exit_us : 0)
+                  << std::endl;
+    }
+
+    std::cout << "Cascade accuracy = " << 100. * cascade_correct / n
+              << "%, mean latency " << 1e6 * cascade_sec / n << " us"
+              << std::endl;
+    std::cout << "Full model accuracy = " << 100. * full_correct / n
+              << "%, mean latency " << full_mean_us << " us" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    std::string command = argv[1];
+    if (command == "train" && argc == 5) {
+        Train(argv[2], argv[3], ParseDims(argv[4]));
+    } else if (command == "predict" && argc == 6) {
+        Predict(argv[2], argv[3], argv[4], argv[5]);
+    } else {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <Eigen/Core>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "classify.hpp"
+
+namespace fs = std::filesystem;
+
+const std::string USAGE =
+    "Usage: ./classify train <reduced.txt> <model>\n"
+    "       ./classify predict <reduced.txt> <model> <predictions.txt>";
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    std::string command = argv[1];
+    if (!(command == "train" && argc == 4) &&
+        !(command == "predict" && argc == 5)) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    LabelledSamples samples = LoadLabelledSamples(argv[2]);
+    if (samples.labels.empty()) {
+        std::cerr << "No samples in " << argv[2] << std::endl;
+        exit(1);
+    }
+
+    fs::path model_file(argv[3]);
+
+    if (command == "train") {
+        SvmModel model = SvmModel::Train(samples.features, samples.labels);
+        model.Save(model_file);
+        return 0;
+    }
+
+    if (!fs::exists(model_file)) {
+        std::cerr << "Could not find file " << model_file << std::endl;
+        exit(2);
+    }
+    SvmModel model = SvmModel::Load(model_file);
+
+    std::vector<int> predictions = model.Predict(samples.features);
+
+    std::ofstream out(argv[4]);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << argv[4] << std::endl;
+        exit(1);
+    }
+
+    int correct = 0;
+    for (int i = 0; i < predictions.size(); i++) {
+        out << predictions[i] << "\n";
+        correct += predictions[i] == samples.labels[i];
+    }
+
+    // Same summary line as svm-predict.
+    int total = predictions.size();
+    std::cout << "Accuracy = " << 100. * correct / total << "% (" << correct
+              << "/" << total << ") (classification)" << std::endl;
+    return 0;
+}
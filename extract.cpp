@@ -1,232 +1,209 @@
-#include <fftw3.h>
+#include "extract.hpp"
 
 #include <Eigen/Core>
-#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "audio.hpp"
 #include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
+#include "reduce.hpp"
+#include "stats.hpp"
 
 namespace fs = std::filesystem;
 
-Eigen::ArrayXXcd STFT(const AudioFile aud, int fftn, int hop);
-constexpr double hz2mel(double hz);
-constexpr double mel2hz(double mel);
-Eigen::ArrayXXd CreateMelFilterbanks(int num_filters, double sample_rate,
-                                     int nfft, double lowfreq, double highfreq);
-Eigen::ArrayXXd ExtractFeature(AudioFile aud, bool images);
-Eigen::ArrayXd BlackmanWindow(int N);
-
-int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 3) {
-        std::cerr << "Usage: ./extract <filename> <image?>" << std::endl;
-        exit(2);
-    }
-
-    fs::path filename(argv[1]);
-    bool images = false;
-    if (argc == 3) {
-        images = std::stoi(argv[2]);
+const std::string USAGE =
+    "Usage: ./extract <filename|files.txt> <image?> <encoding?> "
+    "<configs.csv?>\n"
+    "       ./extract --shard <k>/<n> <files.txt> <image?> <encoding?>";
+
+// Extracts every configuration from one STFT per file. Each output is named
+// <stem>.<tag>.feat, with the encoding inserted as in EncodedPath. Given a
+// listing, the outputs of each configuration are also listed in
+// <listing>.<tag>.txt, and those listings are printed.
+void ExtractConfigs(const fs::path& filename,
+                    const std::vector<FeatureConfig>& configs,
+                    Encoding encoding) {
+    auto output = [&](const fs::path& f, int c) {
+        return EncodedPath(f, "." + configs[c].Tag() + ".feat", encoding);
+    };
+
+    if (filename.extension() != ".txt") {
+        AudioFile aud(filename.string());
+        ExtractorWorkspace workspace;
+        const auto& features =
+            workspace.Extract(aud.data, aud.sample_rate, configs);
+        for (int c = 0; c < configs.size(); c++) {
+            SaveMatrix(output(filename, c), features[c], encoding);
+            std::cout << output(filename, c) << std::endl;
+        }
+        return;
     }
-    AudioFile aud(filename.string());
-
-    Eigen::ArrayXXd feature = ExtractFeature(aud, images);
-
-    fs::path outfile = filename.replace_extension(".feat");
-    SaveCSV(outfile, feature);
-
-    std::cout << outfile << std::endl;
-
-    return 0;
-}
 
-// Rows are bins, columns are frames
-Eigen::ArrayXXcd STFT(Eigen::ArrayXd signal, int fftn, int hop) {
-    // Pad audio to align with window and hop
-    int num_frames = (signal.size() - fftn + hop - 1) / hop + 1;
-    int padding = fftn + hop * (num_frames - 1) - signal.size();
-
-    // std::cout << "num_frames: " << num_frames << std::endl;
-    // std::cout << "signal.size(): " << signal.size() << std::endl;
-    // std::cout << "fftn: " << fftn << std::endl;
-    // std::cout << "hop: " << hop << std::endl;
-    // std::cout << "padding: " << padding << std::endl;
-
-    assert(0 <= padding);
-    assert(padding < hop);
-
-    if (padding > 0) {
-        signal.conservativeResize(signal.size() + padding);
-        for (auto& x : signal.tail(padding)) {
-            x = 0;
+    std::vector<std::ofstream> listings;
+    std::vector<fs::path> listing_files;
+    for (const auto& config : configs) {
+        listing_files.push_back(
+            fs::path(filename).replace_extension("." + config.Tag() + ".txt"));
+        listings.emplace_back(listing_files.back());
+        if (!listings.back().is_open()) {
+            std::cerr << "Failed to create " << listing_files.back()
+                      << std::endl;
+            exit(1);
         }
-    }  // else no padding is needed (hops and window align perfectly)
-
-    Eigen::ArrayXd window = BlackmanWindow(fftn);
-    window /= window.sum();  // normalized window to unit mass
-
-    int num_bins = fftn / 2 + 1;
-    Eigen::ArrayXXcd stft(num_bins, num_frames);
+    }
 
-    fftw_plan fft;
-    for (int i = 0; i < num_frames; i++) {
-        Eigen::ArrayXd sample = signal(Eigen::seqN(i * hop, fftn));
-        Eigen::ArrayXd windowed_sample = window * sample;
+    RunPipeline<AudioFile, std::vector<Eigen::ArrayXXd>>(
+        ReadFileListing(filename),
+        [](const fs::path& f) { return AudioFile(f.string()); },
+        [&](AudioFile aud) -> std::vector<Eigen::ArrayXXd> {
+            thread_local ExtractorWorkspace workspace;
+            return workspace.Extract(aud.data, aud.sample_rate, configs);
+        },
+        [&](const fs::path& f, std::vector<Eigen::ArrayXXd> features) {
+            for (int c = 0; c < configs.size(); c++) {
+                SaveMatrix(output(f, c), features[c], encoding);
+                listings[c] << output(f, c) << "\n";
+            }
+        });
 
-        fft = fftw_plan_dft_r2c_1d(
-            fftn, windowed_sample.data(),
-            reinterpret_cast<fftw_complex*>(stft.col(i).data()), FFTW_ESTIMATE);
-        fftw_execute(fft);
+    for (const auto& f : listing_files) {
+        std::cout << f << std::endl;
     }
-    fftw_free(fft);
-
-    return stft;
 }
 
-// Using HTLK MFCC-FB24 [Ganchev]
-constexpr double hz2mel(double hz) {
-    return 2595 * std::log10(1 + hz / 700.);
-}
+// Extracts this node's share of a listing shared by several nodes. Writes the
+// features as usual, lists them in <listing>.shard<k>of<n>.txt and saves
+// their statistics to <listing>.shard<k>of<n>.stats for merge.
+void ExtractShard(const fs::path& listing, int shard, int num_shards,
+                  Encoding encoding) {
+    std::vector<fs::path> files =
+        ShardFiles(ReadFileListing(listing), shard, num_shards);
+
+    std::string tag = ".shard" + std::to_string(shard) + "of" +
+                      std::to_string(num_shards);
+    fs::path shard_listing = fs::path(listing).replace_extension(tag + ".txt");
+    fs::path stats_file = fs::path(listing).replace_extension(tag + ".stats");
+
+    std::ofstream out(shard_listing);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << shard_listing << std::endl;
+        exit(1);
+    }
 
-constexpr double mel2hz(double mel) {
-    return 700 * (std::pow(10, mel / 2595.) - 1);
+    FeatureStats stats;
+    RunPipeline<AudioFile, Eigen::ArrayXXd>(
+        files, [](const fs::path& f) { return AudioFile(f.string()); },
+        [](AudioFile aud) -> Eigen::ArrayXXd {
+            thread_local ExtractorWorkspace workspace;
+            return workspace.Extract(aud.data, aud.sample_rate);
+        },
+        [&](const fs::path& f, Eigen::ArrayXXd feature) {
+            fs::path outfile = EncodedPath(f, ".feat", encoding);
+            SaveMatrix(outfile, feature, encoding);
+            out << outfile << "\n";
+
+            // Statistics of the feature as stored, so the merged basis
+            // matches running basis on the saved files.
+            Eigen::MatrixXd flat =
+                FlattenFeature(QuantizedMatrix::Encode(feature, encoding)
+                                   .Decode())
+                    .transpose();
+            if (stats.count() == 0) stats = FeatureStats(flat.cols());
+            stats.Add(flat);
+        });
+
+    stats.Save(stats_file);
+    std::cout << shard_listing << std::endl;
+    std::cout << stats_file << std::endl;
 }
 
-// Each row is a filter bank. Each column is an fft bin.
-Eigen::ArrayXXd CreateMelFilterbanks(int num_filters, double sample_rate,
-                                     int nfft, double lowfreq,
-                                     double highfreq) {
-    double mel_center_delta =
-        (hz2mel(highfreq) - hz2mel(lowfreq)) / (num_filters + 1);
-
-    int nbins = nfft / 2 + 1;
-
-    Eigen::ArrayXd fft_freqs =
-        Eigen::ArrayXd::LinSpaced(nbins, 0, sample_rate / 2);
-
-    Eigen::ArrayXXd filters = Eigen::ArrayXXd::Zero(num_filters, nbins);
-
-    for (int j = 1; j <= num_filters; j++) {
-        // Compute vertices of filter
-        double f_low = mel2hz(mel_center_delta * (j - 1));
-        double f_center = mel2hz(mel_center_delta * (j));
-        double f_high = mel2hz(mel_center_delta * (j + 1));
-
-        // Create the triangle filter
-        for (int i = 0; i < nbins; i++) {
-            double f = fft_freqs[i];
-
-            if (f_low <= f && f <= f_center) {
-                filters(j - 1, i) = (f - f_low) / (f_center - f_low);
-            } else if (f_center <= f && f <= f_high) {
-                filters(j - 1, i) = (f_high - f) / (f_high - f_center);
-            } else {
-                continue;  // these cells are already 0
-            }
+int main(int argc, char* argv[]) {
+    int shard = -1;
+    int num_shards = 0;
+    if (argc >= 3 && std::string(argv[1]) == "--shard") {
+        if (std::sscanf(argv[2], "%d/%d", &shard, &num_shards) != 2 ||
+            shard < 0 || shard >= num_shards) {
+            std::cerr << "Shard must be <k>/<n> with 0 <= k < n. Got "
+                      << argv[2] << std::endl;
+            exit(2);
         }
+        argc -= 2;
+        argv += 2;
     }
-    return filters;
-}
 
-Eigen::ArrayXXd ExtractFeature(AudioFile aud, bool images) {
-    /***************************************************************
-        Normalize Amplitude
-    ***************************************************************/
-    double max_amplitude = aud.data.abs().maxCoeff();
-    assert(max_amplitude > 0);
-    Eigen::ArrayXd audio = aud.data / max_amplitude;
-
-    /***************************************************************
-        Power Spectrum
-    ***************************************************************/
-    // Window size and hop is recommended by Fine et al.
-    const double kStepSec = 0.01;
-    const double kWindowSec = 0.025;
-    int hop = kStepSec * aud.sample_rate;
-    int fftn = kWindowSec * aud.sample_rate;
-
-    Eigen::ArrayXXd power_spectrum = STFT(audio, fftn, hop).abs2();
-    if (images) {
-        SaveImage("power_spectrum.png", power_spectrum, 0,
-                  power_spectrum.maxCoeff());
-    }
-    // SaveCSV("power.csv", power_spectrum);
-
-    /***************************************************************
-     Mel Filterbank
-     ***************************************************************/
-    // values from Ganchev
-    const int kNumFilters = 24;
-    const double lowfreq = 0;
-    const double highfreq = 4000;
-    Eigen::ArrayXXd mel_filterbanks = CreateMelFilterbanks(
-        kNumFilters, aud.sample_rate, fftn, lowfreq, highfreq);
-
-    assert(mel_filterbanks.cols() == power_spectrum.rows());
-
-    // Computes kNumFilters datapoints per frame.
-    Eigen::ArrayXXd filtered_power(kNumFilters, power_spectrum.cols());
-
-    for (int j = 0; j < kNumFilters; j++) {
-        Eigen::ArrayXd filter = mel_filterbanks.row(j);
-        for (int i = 0; i < power_spectrum.cols(); i++) {
-            filtered_power(j, i) = (power_spectrum.col(i) * filter).sum();
-        }
+    if (argc < 2 || argc > (shard >= 0 ? 4 : 5)) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
     }
 
-    if (images) {
-        Eigen::ArrayXXd fp_img = (filtered_power + 1e-8).log10();
-        SaveImage("mel_binned.png", fp_img, fp_img.minCoeff(),
-                  fp_img.maxCoeff());
+    fs::path filename(argv[1]);
+    bool images = false;
+    if (argc >= 3) {
+        images = std::stoi(argv[2]);
+    }
+    Encoding encoding = Encoding::kText;
+    if (argc >= 4) {
+        encoding = ParseEncoding(argv[3]);
     }
-    // SaveCSV("mel_power_binned.csv", filtered_power);
-
-    /***************************************************************
-        Pool to reduce time resolution
-    ***************************************************************/
-    // Adjust kNumFilters to change the frequency resolution
-
-    // independent of duration so that all features have same dimensionality.
-    const int kNumPeriods = 8;
 
-    double breaks = static_cast<double>(filtered_power.cols()) / kNumPeriods;
+    if (shard >= 0) {
+        if (images || filename.extension() != ".txt") {
+            std::cerr << "Shards are taken from a .txt listing and do not "
+                         "save images."
+                      << std::endl;
+            exit(2);
+        }
+        ExtractShard(filename, shard, num_shards, encoding);
+        return 0;
+    }
 
-    Eigen::ArrayXXd pooled_power(kNumFilters, kNumPeriods);
-    for (int i = 0; i < kNumPeriods; i++) {
-        int low_i = std::round(i * breaks);
-        int high_i = std::round((i + 1) * breaks);
-        auto seq = Eigen::seq(low_i, high_i - 1);
+    if (argc == 5) {
+        if (images) {
+            std::cerr << "Images are not saved when extracting several "
+                         "configurations."
+                      << std::endl;
+            exit(2);
+        }
+        ExtractConfigs(filename, LoadFeatureConfigs(argv[4]), encoding);
+        return 0;
+    }
 
-        for (int j = 0; j < kNumFilters; j++) {
-            pooled_power(j, i) = filtered_power.row(j)(seq).mean();
-            filtered_power.row(j)(seq) = NAN;
+    if (filename.extension() == ".txt") {
+        if (images) {
+            std::cerr << "Images can only be saved for a single file."
+                      << std::endl;
+            exit(2);
         }
+
+        // Decode the next files while the current ones are being processed.
+        RunPipeline<AudioFile, Eigen::ArrayXXd>(
+            ReadFileListing(filename),
+            [](const fs::path& f) { return AudioFile(f.string()); },
+            [](AudioFile aud) -> Eigen::ArrayXXd {
+                // One per worker so buffers and plans are reused across files.
+                thread_local ExtractorWorkspace workspace;
+                return workspace.Extract(aud.data, aud.sample_rate);
+            },
+            [&](const fs::path& f, Eigen::ArrayXXd feature) {
+                fs::path outfile = EncodedPath(f, ".feat", encoding);
+                SaveMatrix(outfile, feature, encoding);
+                std::cout << outfile << std::endl;
+            });
+        return 0;
     }
 
-    // Check used all elements exactly once
-    assert(filtered_power.isNaN().all());
-    assert(!(pooled_power.isNaN()).any());
+    AudioFile aud(filename.string());
 
-    /***************************************************************
-        Take log10 of pooled_power power
-    ***************************************************************/
-    const double epsilon = 1e-8;  // to avoid log(0)
-    Eigen::ArrayXXd pooled = (pooled_power + epsilon).log10();
-    assert(!pooled.isNaN().any());
+    Eigen::ArrayXXd feature = ExtractFeature(aud, images);
 
-    if (images) {
-        SaveImage("pooled_mel.png", pooled, pooled.minCoeff(),
-                  pooled.maxCoeff());
-    }
+    fs::path outfile = EncodedPath(filename, ".feat", encoding);
+    SaveMatrix(outfile, feature, encoding);
 
-    return pooled;
-}
+    std::cout << outfile << std::endl;
 
-Eigen::ArrayXd BlackmanWindow(int N) {
-    constexpr double PI = 3.14159265358979323;
-    // https://numpy.org/doc/stable/reference/routines.window.html
-    return Eigen::ArrayXd::LinSpaced(N, 0, N - 1).unaryExpr([&](double n) {
-        return 0.42 - 0.5 * std::cos(2. * PI * n / (N - 1)) +
-               0.08 * std::cos(4. * PI * n / (N - 1));
-    });
-}
\ No newline at end of file
+    return 0;
+}
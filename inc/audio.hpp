@@ -1,10 +1,11 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <string>
 
 struct AudioFile {
     int sample_rate;
     Eigen::ArrayXd data;
 
-    AudioFile(std::string filename);
+    AudioFile(const std::string& filename);
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <vector>
+
+// Ranges each transform is drawn from, uniformly. A zero range or
+// probability turns the transform off.
+struct AugmentOptions {
+    uint64_t seed = 748;
+
+    // Resampling by a factor in [1 - x, 1 + x]. Changes tempo and pitch
+    // together, like `sox speed`.
+    double max_speed_change = 0.1;
+
+    // Silence added before (or after, if negative) the clip. Moves the word
+    // relative to the pooling periods.
+    double max_shift_sec = 0.1;
+
+    // Background clip from the pool, mixed in at a random offset.
+    double background_probability = 0.5;
+    double min_background_snr_db = 5;
+    double max_background_snr_db = 20;
+
+    // White Gaussian noise.
+    double noise_probability = 1;
+    double min_noise_snr_db = 10;
+    double max_noise_snr_db = 40;
+
+    // Extraction normalizes the peak amplitude, so gain alone does not
+    // change features. Off by default.
+    double max_gain_db = 0;
+};
+
+// Seeded transforms applied to audio before extraction, so augmented
+// features can be computed on the fly instead of from augmented copies on
+// disk.
+//
+// The transforms applied to a copy depend only on the seed, the clip id and
+// the copy number, so the output does not depend on the order or the thread
+// that clips are processed in. Apply is safe to call concurrently.
+class Augmenter {
+public:
+    // `backgrounds` is the pool for background mixing, already at the sample
+    // rate of the clips.
+    explicit Augmenter(AugmentOptions options,
+                       std::vector<Eigen::ArrayXd> backgrounds = {});
+
+    // Speed, shift, background, noise then gain. `clip_id` should be stable
+    // for a clip, e.g. Fnv1a of its file name.
+    Eigen::ArrayXd Apply(const Eigen::ArrayXd& clip, int sample_rate,
+                         uint64_t clip_id, int copy) const;
+
+private:
+    AugmentOptions options_;
+    std::vector<Eigen::ArrayXd> backgrounds_;
+};
+
+// Resamples by linear interpolation so the result plays `factor` times
+// faster.
+Eigen::ArrayXd ChangeSpeed(const Eigen::ArrayXd& clip, double factor);
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <filesystem>
+
+#include "classify.hpp"
+#include "extract.hpp"
+#include "fileio.hpp"
+#include "simd.hpp"
+
+// Bumped whenever the layout of a bundle changes. Older bundles are rejected
+// rather than misread. The extractor's compiled-in kStepSec, kWindowSec and
+// kEpsilon are stored in the header and must match when a bundle is opened.
+constexpr uint32_t kBundleVersion = 3;
+
+// Every array starts on a multiple of this many bytes, so the mapped views are
+// aligned for vector loads.
+constexpr size_t kBundleAlignment = 64;
+
+// Everything needed to go from audio to a digit in one binary file: the
+// extractor settings and mel filterbank, the mean and the truncated basis,
+// and the SVM's support vectors and coefficients.
+//
+// The file is mapped rather than read, so opening one parses only a fixed
+// size header and the arrays are used in place through Eigen::Map. The
+// filterbank is stored in the banded layout extraction uses, so it is read in
+// place too. Processes serving the same bundle share its pages. Bundles are
+// written in the host's byte order and are only readable on little-endian
+// hosts.
+class ModelBundle {
+public:
+    // Fixed size, at the start of the file. Array offsets are in bytes from
+    // the start of the file. Matrices are column-major doubles.
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t file_size;
+
+        // Extractor
+        int32_t sample_rate;
+        int32_t num_filters;
+        int32_t num_bins;
+        int32_t num_periods;
+        int64_t num_weights;  // in all filter bands
+        double lowfreq;
+        double highfreq;
+        double step_sec;    // kStepSec
+        double window_sec;  // kWindowSec
+        double epsilon;     // kEpsilon
+
+        // Projection
+        int32_t feature_dims;
+        int32_t dims;
+
+        // Classifier
+        int32_t kernel;  // libsvm kernel_type, LINEAR or RBF
+        int32_t num_classes;
+        int32_t num_svs;
+        int32_t padding;
+        double gamma;
+
+        uint64_t first_bin_offset;    // num_filters int32
+        uint64_t band_offset;         // num_filters + 1 int32, into weights
+        uint64_t weights_offset;      // num_weights
+        uint64_t mean_offset;         // feature_dims
+        uint64_t basis_offset;        // feature_dims x dims
+        uint64_t labels_offset;       // num_classes int32
+        uint64_t class_sizes_offset;  // num_classes int32, libsvm nSV
+        uint64_t svs_offset;          // dims x num_svs
+        uint64_t coefs_offset;  // num_svs x (num_classes - 1), libsvm sv_coef
+        uint64_t rho_offset;    // one per pair of classes
+    };
+
+    // Throws std::runtime_error if the file is not a bundle of this version,
+    // was built with other extractor constants, or has a kernel other than
+    // linear or RBF.
+    explicit ModelBundle(std::filesystem::path filename);
+
+    ModelBundle(const ModelBundle&) = delete;
+    ModelBundle& operator=(const ModelBundle&) = delete;
+
+    // `basis` and `mean` are as written by `basis`, with the largest
+    // eigenvalues on the right. Only the last `dims` columns are stored, in
+    // reverse so the leading component comes first. `model` must use the
+    // linear or RBF kernel on features reduced to `dims`.
+    static void Save(std::filesystem::path filename,
+                     const FeatureConfig& config, int sample_rate,
+                     const Eigen::MatrixXd& basis, const Eigen::VectorXd& mean,
+                     int dims, const SvmModel& model);
+
+    const FeatureConfig& config() const { return config_; }
+    int sample_rate() const;
+    int dims() const;
+
+    // A view of the mapped filter bands.
+    const BandedFilterbank& filterbank() const { return filterbanks_; }
+    Eigen::Map<const Eigen::VectorXd> mean() const;
+    Eigen::Map<const Eigen::MatrixXd> basis() const;  // features x dims
+
+    // Same as reduce with this bundle's basis.
+    Eigen::VectorXd Reduce(const Eigen::ArrayXXd& feature) const;
+
+    // Same label as SvmModel::Predict, computed with dense kernels over the
+    // mapped support vectors.
+    int Predict(const Eigen::VectorXd& reduced) const;
+
+    // Extract, Reduce and Predict. Throws std::invalid_argument if the audio
+    // is not at the bundle's sample rate.
+    int Classify(const Eigen::Ref<const Eigen::ArrayXd>& audio,
+                 int sample_rate, ExtractorWorkspace& workspace) const;
+
+private:
+    const Header& header() const;
+    template <typename T>
+    const T* Section(uint64_t offset) const;
+
+    MappedFile file_;
+    FeatureConfig config_;
+    BandedFilterbank filterbanks_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <vector>
+
+#include "classify.hpp"
+#include "quantize.hpp"
+
+// Classifies on a few leading principal components first, and only projects
+// onto more components and runs a stronger model when the margin is small.
+//
+// Every stage but the last is a linear SVM on the first `dims` reduced
+// dimensions. The last is an RBF SVM, the same as classify, on the most
+// dimensions. A sample exits at the first stage whose margin reaches that
+// stage's threshold.
+class Cascade {
+public:
+    struct Stage {
+        int dims;
+        double threshold;  // never reached by the last stage
+        SvmModel model;
+        LinearSvm linear;  // every stage but the last
+    };
+
+    struct Prediction {
+        int label;
+        int stage;  // where the sample exited
+    };
+
+    // `reduced` has one reduced feature per row with at least dims.back()
+    // dimensions. `dims` must be increasing.
+    //
+    // Thresholds are calibrated by five-fold cross-validation, so each sample
+    // is scored by models trained without it. Each is the smallest margin
+    // such that, of the samples reaching the stage with at least that margin,
+    // the stage gets right every one the last stage gets right. The models
+    // are then retrained on every sample.
+    static Cascade Train(const Eigen::MatrixXd& reduced,
+                         const std::vector<int>& labels,
+                         const std::vector<int>& dims);
+
+    // Writes <stem>.cascade with the dims and threshold of each stage and
+    // <stem>.stage<k>.model for each model.
+    void Save(std::filesystem::path stem) const;
+    static Cascade Load(std::filesystem::path stem);
+
+    // `centered` is a flattened feature minus the basis mean. Components are
+    // projected only when a stage needs them. If `stage_seconds` is given,
+    // the time spent in each stage is added to it.
+    Prediction Predict(const Eigen::VectorXd& centered,
+                       const QuantizedMatrix& basis,
+                       std::vector<double>* stage_seconds = nullptr) const;
+
+    const std::vector<Stage>& stages() const { return stages_; }
+
+private:
+    std::vector<Stage> stages_;
+};
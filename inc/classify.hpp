@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "svm.h"
+
+enum class SvmKernel {
+    kLinear,
+    kRbf,
+};
+
+// A libsvm model trained and evaluated in process. Samples are the rows of a
+// dense matrix and are handed to libsvm as one svm_node per dimension, the
+// same as the sparse files written by prep-svm.
+class SvmModel {
+public:
+    SvmModel() = default;
+    ~SvmModel();
+
+    SvmModel(SvmModel&& other) noexcept;
+    SvmModel& operator=(SvmModel&& other) noexcept;
+    SvmModel(const SvmModel&) = delete;
+    SvmModel& operator=(const SvmModel&) = delete;
+
+    // Uses the svm-train defaults: C-SVC with C = 1, and gamma = 1 / dims for
+    // the RBF kernel.
+    static SvmModel Train(const Eigen::MatrixXd& samples,
+                          const std::vector<int>& labels,
+                          SvmKernel kernel = SvmKernel::kRbf);
+
+    // Same format as svm-train, so models are interchangeable with the CLI.
+    void Save(std::filesystem::path filename) const;
+    static SvmModel Load(std::filesystem::path filename);
+
+    int Predict(const Eigen::VectorXd& sample) const;
+
+    // Also sets `margin` to the winning class's smallest pairwise decision
+    // value. See VoteWithMargin.
+    int Predict(const Eigen::VectorXd& sample, double* margin) const;
+
+    // Splits the rows into one contiguous block per thread.
+    std::vector<int> Predict(const Eigen::MatrixXd& samples,
+                             int num_threads = DefaultThreadCount()) const;
+
+    const svm_model* model() const { return model_; }
+
+private:
+    svm_model* model_ = nullptr;
+
+    // A trained model's support vectors point into the training nodes, so
+    // they live as long as the model.
+    std::vector<svm_node> nodes_;
+};
+
+// A linear-kernel SvmModel with each pair's support vectors summed into one
+// weight vector, so a prediction costs one dot product per pair of classes
+// regardless of the number of support vectors.
+class LinearSvm {
+public:
+    LinearSvm() = default;
+
+    // `dims` is the length of the samples the model was trained on. It
+    // cannot be read from the model, whose support vectors may omit trailing
+    // zero features. Throws std::invalid_argument if a support vector is
+    // longer.
+    LinearSvm(const SvmModel& model, int dims);
+
+    int Predict(const Eigen::VectorXd& sample, double* margin) const;
+
+private:
+    Eigen::MatrixXd weights_;  // one row per pair, in libsvm's order
+    Eigen::VectorXd rho_;
+    std::vector<int> labels_;
+};
+
+// Sums per-support-vector rows into one row per pair of classes, in libsvm's
+// pair order and with the coefficients svm_predict_values uses: for the pair
+// (i, j), class i's support vectors are weighted by coefficient column j - 1
+// and class j's by column i. Support vectors are grouped by class, with
+// class_sizes[c] (libsvm's nSV) in class c, and `coefs` has one row per
+// support vector and one column per class but one.
+//
+// With `rows` the kernel between each support vector and a sample, the result
+// is the decision values plus rho. With `rows` the support vectors themselves,
+// it is each pair's weight vector of a linear model.
+Eigen::MatrixXd CombinePairs(const Eigen::Ref<const Eigen::MatrixXd>& coefs,
+                             const int* class_sizes,
+                             const Eigen::Ref<const Eigen::MatrixXd>& rows);
+
+// Tallies one-vs-one decision values in libsvm's pair order, (0, 1), (0, 2),
+// ..., (1, 2), ..., where a positive value is a vote for the first class.
+// Returns the index of the winning class, ties going to the lowest index as in
+// svm_predict. `margin` is set to the smallest decision value among the
+// winner's pairs, signed so that positive favours the winner.
+int VoteWithMargin(const Eigen::VectorXd& decision_values, int num_classes,
+                   double* margin);
+
+struct LabelledSamples {
+    Eigen::MatrixXd features;  // one reduced feature per row
+    std::vector<int> labels;
+};
+
+// Loads every .reduced file in the listing. Each column of a file is one
+// sample, so a file may hold several, e.g. the augmented copies of a clip.
+// The label is the first character of the file name, as in prep-svm.
+LabelledSamples LoadLabelledSamples(std::filesystem::path listing);
+
+// One svm_node per column of `samples`, each row ending in the index -1
+// terminator. `rows` receives a pointer to the start of each row.
+std::vector<svm_node> ToSvmNodes(const Eigen::MatrixXd& samples,
+                                 std::vector<svm_node*>& rows);
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "audio.hpp"
+#include "simd.hpp"
+
+struct fftw_plan_s;
+
+// Window size and hop is recommended by Fine et al.
+constexpr double kStepSec = 0.01;
+constexpr double kWindowSec = 0.025;
+
+// values from Ganchev
+constexpr int kNumFilters = 24;
+constexpr double kLowFreq = 0;
+constexpr double kHighFreq = 4000;
+
+// Adjust kNumFilters to change the frequency resolution.
+// kNumPeriods is independent of duration so that all features have same
+// dimensionality.
+constexpr int kNumPeriods = 8;
+
+constexpr double kEpsilon = 1e-8;  // to avoid log(0)
+
+// Mel filterbank and pooling settings. The defaults are the constants above.
+struct FeatureConfig {
+    int num_filters = kNumFilters;
+    double lowfreq = kLowFreq;
+    double highfreq = kHighFreq;
+    int num_periods = kNumPeriods;
+
+    bool operator==(const FeatureConfig&) const = default;
+
+    // Used in output file names, e.g. "m24-0-4000-p8".
+    std::string Tag() const;
+};
+
+// CSV with the header num_filters,lowfreq,highfreq,num_periods and one
+// configuration per line.
+std::vector<FeatureConfig> LoadFeatureConfigs(std::filesystem::path filename);
+
+// STFT hop and window length in samples.
+int HopSize(int sample_rate);
+int WindowSize(int sample_rate);
+
+// Each row is a filter bank. Each column is an fft bin.
+Eigen::ArrayXXd CreateMelFilterbanks(int num_filters, double sample_rate,
+                                     int nfft, double lowfreq, double highfreq);
+
+// Buffers, window, filterbanks and FFT plan reused from clip to clip.
+//
+// Buffers only grow, so once the longest clip has been seen extraction makes
+// no heap allocations. A workspace is not thread-safe. Give each worker
+// thread its own.
+class ExtractorWorkspace {
+public:
+    ExtractorWorkspace() = default;
+    ~ExtractorWorkspace();
+    ExtractorWorkspace(const ExtractorWorkspace&) = delete;
+    ExtractorWorkspace& operator=(const ExtractorWorkspace&) = delete;
+
+    // Mel filtered power of each frame of signal / max_amplitude. Rows are
+    // filters, columns are frames. Valid until the next call.
+    Eigen::Ref<const Eigen::ArrayXXd> MelFrames(
+        const Eigen::Ref<const Eigen::ArrayXd>& signal, int sample_rate,
+        double max_amplitude = 1);
+
+    // Pooled log mel power of a clip. Rows are filters, columns are periods.
+    // Valid until the next call.
+    const Eigen::ArrayXXd& Extract(
+        const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate);
+
+    // Pooled log mel power for each configuration, all from one power
+    // spectrum. Pooling uses running totals over frames so it costs the same
+    // for any number of periods. Valid until the next call.
+    const std::vector<Eigen::ArrayXXd>& Extract(
+        const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate,
+        const std::vector<FeatureConfig>& configs);
+
+    // Pooled log mel power with a precomputed filterbank, such as the one in
+    // a ModelBundle. It must have been built for WindowSize(sample_rate).
+    // Valid until the next call.
+    const Eigen::ArrayXXd& Extract(
+        const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate,
+        const BandedFilterbank& filterbanks, int num_periods);
+
+    // Use simd::FastLog10 for the final log. Defaults to DefaultFastLog().
+    void SetFastLog(bool fast_log) { fast_log_ = fast_log; }
+
+    // Intermediate results of the last call.
+    Eigen::Ref<const Eigen::ArrayXXd> PowerSpectrum() const;
+    Eigen::Ref<const Eigen::ArrayXXd> FilteredPower() const;
+
+private:
+    void Prepare(int sample_rate);
+    void PrepareConfigs(const std::vector<FeatureConfig>& configs);
+    void Reserve(int num_frames);
+    void PowerFrames(const Eigen::Ref<const Eigen::ArrayXd>& signal,
+                     int sample_rate, double max_amplitude);
+    // Filters, pools and takes the log of the last power spectrum.
+    void PoolLogMel(const BandedFilterbank& filterbanks, int num_periods,
+                    Eigen::ArrayXXd& pooled);
+
+    int sample_rate_ = 0;
+    int hop_ = 0;
+    int fftn_ = 0;
+    int num_frames_ = 0;
+    bool fast_log_ = DefaultFastLog();
+
+    Eigen::ArrayXd window_;
+    BandedFilterbank mel_filterbanks_;
+    fftw_plan_s* plan_ = nullptr;
+    double* frame_ = nullptr;          // fftw_malloc'd, fftn
+    double (*spectrum_)[2] = nullptr;  // fftw_malloc'd, fftn / 2 + 1
+
+    Eigen::ArrayXXd power_spectrum_;  // bins x frame capacity
+    Eigen::ArrayXXd filtered_power_;  // filters x frame capacity
+    Eigen::ArrayXXd pooled_;
+
+    // Multi-configuration extraction. Filterbanks are rebuilt when the
+    // configurations or the sample rate change.
+    std::vector<FeatureConfig> configs_;
+    std::vector<BandedFilterbank> config_filterbanks_;
+    std::vector<Eigen::ArrayXXd> config_pooled_;
+    Eigen::ArrayXXd cumulative_;  // filters x (frames + 1) capacity
+};
+
+// Pooled log mel power. Rows are filters, columns are periods.
+Eigen::ArrayXXd ExtractFeature(const AudioFile& aud, bool images);
+
+Eigen::ArrayXd BlackmanWindow(int N);
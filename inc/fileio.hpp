@@ -1,7 +1,10 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <string>
 #include <vector>
 
 void SaveCSV(std::filesystem::path filename, const Eigen::ArrayXXd& array,
@@ -15,4 +18,24 @@ std::vector<std::filesystem::path> ReadFileListing(
     std::filesystem::path list_txt);
 
 void SaveImage(std::filesystem::path filename, Eigen::ArrayXXd values,
-               double min, double max);
\ No newline at end of file
+               double min, double max);
+
+// Read-only mapping of a whole file, unmapped on destruction. data() is null
+// if the file could not be mapped. Read-only mappings of one file share the
+// page cache, so processes mapping the same file share physical memory.
+class MappedFile {
+public:
+    // `sequential` hints that the file will be read once from start to end.
+    explicit MappedFile(const std::string& filename, bool sequential = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
\ No newline at end of file
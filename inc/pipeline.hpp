@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use. Reads the PROJ748_THREADS environment
+// variable, falling back to the hardware concurrency.
+int DefaultThreadCount();
+
+// 64-bit FNV-1a hash. Stable across platforms and runs, unlike std::hash.
+uint64_t Fnv1a(const std::string& s);
+
+// The files assigned to `shard` of `num_shards`, chosen by the FNV-1a hash of
+// each path as written in the listing. Every process given the same listing
+// agrees on the partition without coordinating, and the shards are disjoint
+// and cover every file.
+std::vector<std::filesystem::path> ShardFiles(
+    const std::vector<std::filesystem::path>& files, int shard,
+    int num_shards);
+
+// Fixed capacity FIFO shared between threads. Push blocks while the queue is
+// full so a fast producer cannot run ahead of a slow consumer.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    void Push(T item) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    // Blocks until an item is available. Returns nullopt once the queue has
+    // been closed and drained.
+    std::optional<T> Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return std::nullopt;
+
+        T item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return item;
+    }
+
+    void Close() {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+struct PipelineOptions {
+    int readers = 2;   // threads blocking on file reads
+    int prefetch = 8;  // files loaded ahead of the compute stage
+    int workers = DefaultThreadCount();
+};
+
+// Runs read -> compute -> write over every file in `files`.
+//
+// `read` is called from the reader threads and `compute` from the worker
+// threads, so both must be safe to call concurrently. `write` is called from
+// the calling thread in the same order as `files`.
+//
+// At most prefetch + 2 * workers files are in flight at once, which caps
+// memory regardless of which stage is the bottleneck. The first exception
+// thrown by any stage stops the pipeline and is rethrown here.
+template <typename Loaded, typename Result>
+void RunPipeline(
+    const std::vector<std::filesystem::path>& files,
+    std::function<Loaded(const std::filesystem::path&)> read,
+    std::function<Result(Loaded)> compute,
+    std::function<void(const std::filesystem::path&, Result)> write,
+    PipelineOptions options = {}) {
+    const int readers = std::max(1, options.readers);
+    const int workers = std::max(1, options.workers);
+    const size_t prefetch = std::max(1, options.prefetch);
+    const size_t window = prefetch + 2 * workers;
+
+    BoundedQueue<std::pair<size_t, Loaded>> loaded(prefetch);
+    BoundedQueue<std::pair<size_t, Result>> results(workers);
+
+    // Readers may only start file i once file i - window has been written.
+    std::mutex window_mutex;
+    std::condition_variable window_cv;
+    size_t next_read = 0;
+    size_t written = 0;
+
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard lock(window_mutex);
+            if (!error) error = e;
+            failed = true;
+        }
+        window_cv.notify_all();
+    };
+
+    std::atomic<int> readers_left = readers;
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&] {
+            while (true) {
+                size_t i;
+                {
+                    std::unique_lock lock(window_mutex);
+                    window_cv.wait(lock, [&] {
+                        return failed || next_read >= files.size() ||
+                               next_read < written + window;
+                    });
+                    if (failed || next_read >= files.size()) break;
+                    i = next_read++;
+                }
+                try {
+                    loaded.Push({i, read(files[i])});
+                } catch (...) {
+                    fail(std::current_exception());
+                    break;
+                }
+            }
+            if (--readers_left == 0) loaded.Close();
+        });
+    }
+
+    std::atomic<int> workers_left = workers;
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back([&] {
+            while (auto item = loaded.Pop()) {
+                if (failed) continue;  // drain so readers are not blocked
+                try {
+                    results.Push(
+                        {item->first, compute(std::move(item->second))});
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            if (--workers_left == 0) results.Close();
+        });
+    }
+
+    // Writer stage. Results arrive out of order so hold them until their turn.
+    std::map<size_t, Result> pending;
+    while (auto item = results.Pop()) {
+        if (failed) continue;
+        pending.emplace(item->first, std::move(item->second));
+
+        while (!failed && !pending.empty() &&
+               pending.begin()->first == written) {
+            try {
+                write(files[written], std::move(pending.begin()->second));
+            } catch (...) {
+                fail(std::current_exception());
+            }
+            pending.erase(pending.begin());
+            {
+                std::lock_guard lock(window_mutex);
+                written++;
+            }
+            window_cv.notify_all();
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// How a matrix is stored on disk. The values are written in binary headers so
+// must not change.
+enum class Encoding {
+    kText = 0,     // Full precision CSV, ~20 bytes per value.
+    kFloat16 = 1,  // IEEE half precision, 2 bytes per value.
+    kInt8 = 2,     // Per-column affine int8, 1 byte per value.
+    kFloat64 = 3,  // Lossless binary, 8 bytes per value.
+};
+
+Encoding ParseEncoding(const std::string& name);
+std::string EncodingName(Encoding encoding);
+
+// `file` with its extension replaced by `extension` (e.g. ".feat"), with the
+// encoding name inserted before it unless the encoding is text. Runs with
+// different encodings then write side by side instead of over each other.
+std::filesystem::path EncodedPath(const std::filesystem::path& file,
+                                  const std::string& extension,
+                                  Encoding encoding);
+
+// A matrix held in its storage encoding. Int8 values decode to
+// offset(col) + scale(col) * q(row, col).
+struct QuantizedMatrix {
+    Encoding encoding = Encoding::kText;
+    Eigen::ArrayXXd dense;  // kText and kFloat64
+    Eigen::Array<Eigen::half, Eigen::Dynamic, Eigen::Dynamic> half;  // kFloat16
+    Eigen::Array<int8_t, Eigen::Dynamic, Eigen::Dynamic> q;          // kInt8
+    Eigen::ArrayXd scale;                                            // kInt8
+    Eigen::ArrayXd offset;                                           // kInt8
+
+    static QuantizedMatrix Encode(const Eigen::ArrayXXd& values,
+                                  Encoding encoding);
+    Eigen::ArrayXXd Decode() const;
+
+    int rows() const;
+    int cols() const;
+
+    // Computes cols [first_col, first_col + num_cols)^T * x, dequantizing on
+    // the fly instead of materializing the decoded matrix.
+    Eigen::VectorXd TransposeProduct(const Eigen::VectorXd& x, int first_col,
+                                     int num_cols) const;
+};
+
+// Binary encodings start with a small header. Text is written with SaveCSV.
+void SaveMatrix(std::filesystem::path filename, const Eigen::ArrayXXd& array,
+                Encoding encoding);
+void SaveMatrix(std::filesystem::path filename, const QuantizedMatrix& matrix);
+
+// Detects the encoding from the file contents.
+QuantizedMatrix LoadQuantized(std::filesystem::path filename);
+Eigen::ArrayXXd LoadMatrix(std::filesystem::path filename);
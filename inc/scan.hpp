@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <deque>
+#include <utility>
+
+#include "pipeline.hpp"
+#include "simd.hpp"
+
+// Mel power of every frame of the recording, computed once. The frames are
+// split into one contiguous segment per thread. Each segment is given exactly
+// the samples its frames cover, so the result is the same as one STFT over
+// the whole signal.
+Eigen::ArrayXXd ParallelMelFrames(const Eigen::ArrayXd& signal,
+                                  int sample_rate, int num_threads);
+
+// Features of many windows of one long recording from a single STFT.
+//
+// Each window is pooled from running totals of the mel frames, so it costs
+// O(filters x periods) whatever its length. The totals are kept as
+// double-double (TwoSum) pairs: a plain running total over a whole recording
+// is dominated by its loud parts, and the difference of two such totals for a
+// quiet window late in it would cancel catastrophically.
+//
+// The scanner keeps a reference to `signal`, which must outlive it.
+class RecordingScanner {
+public:
+    RecordingScanner(const Eigen::ArrayXd& signal, int sample_rate,
+                     int num_threads = DefaultThreadCount());
+
+    int num_frames() const { return num_frames_; }
+
+    // First and one past the last sample covered by frames
+    // [first_frame, first_frame + num_frames).
+    std::pair<int, int> Span(int first_frame, int num_frames) const;
+
+    // Same as ExtractorWorkspace::Extract on the samples Span() covers, up to
+    // rounding: pooled log mel power, normalized by the window's own peak
+    // amplitude. Rows are filters, columns are periods. Windows are cheapest
+    // when requested in order of start and end. Valid until the next call.
+    const Eigen::ArrayXXd& Extract(int first_frame, int num_frames);
+
+    // Use simd::FastLog10 for the final log. Defaults to DefaultFastLog().
+    void SetFastLog(bool fast_log) { fast_log_ = fast_log; }
+
+private:
+    // Peak amplitude of frames [first, last), from a sliding maximum over the
+    // peaks of single frames.
+    double MaxAmplitude(int first, int last);
+
+    const Eigen::ArrayXd& signal_;
+    int hop_;
+    int fftn_;
+    int num_frames_;
+    bool fast_log_ = DefaultFastLog();
+
+    // Column i is the sum of frames [0, i) as sum_ + error_.
+    Eigen::ArrayXXd sum_;
+    Eigen::ArrayXXd error_;
+
+    Eigen::ArrayXd frame_peaks_;  // peak amplitude of each frame's samples
+    std::deque<int> peak_frames_;  // frames with decreasing peaks
+    int first_ = 0;  // window of the sliding maximum
+    int last_ = 0;
+
+    Eigen::ArrayXXd pooled_;
+};
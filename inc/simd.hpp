@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Hand vectorized kernels for the element-wise stages of extraction. The
+// instruction set is chosen once at runtime, so one binary uses AVX-512, AVX2
+// or SSE4.2 where the host has them and portable code elsewhere.
+enum class SimdLevel {
+    kScalar = 0,  // whatever the compiler generates for the build's -march
+    kSse42 = 1,   // SSE4.2, two doubles per vector and no FMA
+    kAvx2 = 2,    // AVX2 and FMA
+    kAvx512 = 3,  // AVX-512F
+};
+
+// Best level the host supports. The PROJ748_SIMD environment variable
+// (scalar, sse4.2, avx2 or avx512) can lower it, e.g. to compare levels.
+SimdLevel ActiveSimdLevel();
+std::string SimdLevelName(SimdLevel level);
+
+// Whether extraction uses FastLog10. Reads the PROJ748_FAST_LOG environment
+// variable, defaulting to off.
+bool DefaultFastLog();
+
+// A filterbank stored as one contiguous band of weights per filter, so each
+// filter only touches the bins it covers. Mel filters are triangles, so this
+// skips nearly all of the dense matrix.
+//
+// The arrays are views, either of `storage` or of a mapped model bundle, so
+// copies share the weights.
+struct BandedFilterbank {
+    int num_bins = 0;
+    std::span<const int32_t> first_bin;  // per filter
+    std::span<const int32_t> offset;     // per filter into weights, plus end
+    std::span<const double> weights;
+    std::shared_ptr<const void> storage;  // null if the arrays are mapped
+
+    // Each row of `filters` is a filter. Each column is an fft bin. The
+    // result owns its arrays.
+    static BandedFilterbank FromDense(const Eigen::ArrayXXd& filters);
+    int num_filters() const { return first_bin.size(); }
+};
+
+namespace simd {
+
+// out[i] = window[i] * (signal[i] / scale)
+void WindowFrame(const double* window, const double* signal, double scale,
+                 double* out, int n);
+
+// out[i] = |spectrum[i]|^2 for n interleaved (real, imaginary) pairs.
+void Abs2(const double* spectrum, double* out, int n);
+
+// out[f] = filter f applied to one frame of power.
+void ApplyFilterbank(const BandedFilterbank& filters, const double* power,
+                     double* out);
+
+// x[i] = log10(x[i] + epsilon), using FastLog10 if `fast`. The exact path is
+// scalar std::log10 since there is no vector libm to call.
+void Log10(double* x, int n, double epsilon, bool fast);
+
+// log10 of a positive, normal x from its exponent and a polynomial in the
+// mantissa. Absolute error is below 1e-11, a hundredth of the feature
+// tolerance in regress.
+double FastLog10(double x);
+
+}  // namespace simd
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <vector>
+
+#include "quantize.hpp"
+
+// Sufficient statistics for the mean and covariance of a set of features.
+//
+// Stored as the sum of [1; x][1; x]^T over every feature x, so (0, 0) is the
+// count, the rest of column 0 is the sum of features and the bottom-right
+// block is the sum of outer products. Adding, removing and merging sets of
+// features are all additions, so a basis can be updated without rereading
+// the features it was built from.
+class FeatureStats {
+public:
+    explicit FeatureStats(int dims = 0);
+
+    // Each row of `features` is one feature vector.
+    void Add(const Eigen::MatrixXd& features);
+    void Remove(const Eigen::MatrixXd& features);
+    void Merge(const FeatureStats& other);
+
+    int dims() const;
+    double count() const;
+    Eigen::VectorXd Mean() const;
+    Eigen::MatrixXd Covariance() const;
+
+    // Saved losslessly since rounding would accumulate over updates.
+    void Save(std::filesystem::path filename) const;
+    static FeatureStats Load(std::filesystem::path filename);
+
+private:
+    Eigen::MatrixXd moments_;  // only the lower triangle is maintained
+};
+
+// Principal components of the statistics. Writes the eigenvalues to
+// <stem>.scree, the eigenvectors (largest eigenvalue on the right) to
+// <stem>.basis, the mean to <stem>.mean and the statistics themselves to
+// <stem>.stats. Returns the paths written.
+std::vector<std::filesystem::path> SaveBasis(std::filesystem::path stem,
+                                             const FeatureStats& stats,
+                                             Encoding encoding);
@@ -0,0 +1,85 @@
+#include "bundle.hpp"
+
+#include <Eigen/Core>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "audio.hpp"
+#include "extract.hpp"
+#include "fileio.hpp"
+#include "pipeline.hpp"
+
+namespace fs = std::filesystem;
+
+const std::string USAGE =
+    "Usage: ./infer <model.bundle> <filename>\n"
+    "       ./infer <model.bundle> <wavs.txt> <predictions.txt>";
+
+// Classifies audio end to end with a bundle written by `bundle`, with no
+// intermediate files. Given one .wav file, prints its digit. Given a listing,
+// writes one digit per line and prints the accuracy against the labels in the
+// file names, as `classify predict` does.
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    fs::path bundle_file(argv[1]);
+    fs::path input(argv[2]);
+    for (const auto& f : {bundle_file, input}) {
+        if (!fs::exists(f)) {
+            std::cerr << "Could not find file " << f << std::endl;
+            exit(2);
+        }
+    }
+    if ((input.extension() == ".txt") != (argc == 4)) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    const ModelBundle bundle(bundle_file);
+
+    if (argc == 3) {
+        AudioFile aud(input.string());
+        ExtractorWorkspace workspace;
+        std::cout << bundle.Classify(aud.data, aud.sample_rate, workspace)
+                  << std::endl;
+        return 0;
+    }
+
+    std::ofstream out(argv[3]);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << argv[3] << std::endl;
+        exit(1);
+    }
+
+    std::vector<fs::path> wav_files = ReadFileListing(input);
+    if (wav_files.empty()) {
+        std::cerr << "No files in " << input << std::endl;
+        exit(1);
+    }
+
+    int correct = 0;
+    int total = 0;
+    RunPipeline<AudioFile, int>(
+        wav_files,
+        [](const fs::path& f) { return AudioFile(f.string()); },
+        [&](AudioFile aud) {
+            thread_local ExtractorWorkspace workspace;
+            return bundle.Classify(aud.data, aud.sample_rate, workspace);
+        },
+        [&](const fs::path& f, int prediction) {
+            out << prediction << "\n";
+            correct += prediction == f.filename().string()[0] - '0';
+            total++;
+        });
+
+    // Same summary line as svm-predict.
+    std::cout << "Accuracy = " << 100. * correct / total << "% (" << correct
+              << "/" << total << ") (classification)" << std::endl;
+    return 0;
+}
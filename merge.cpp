@@ -0,0 +1,80 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "quantize.hpp"
+#include "stats.hpp"
+
+namespace fs = std::filesystem;
+
+const std::string USAGE =
+    "Usage: ./merge <out-stem> <encoding> <shard.txt> <shard.txt...>";
+
+// Combines the shards written by `extract --shard`. The statistics are sums,
+// so merging is exact and the basis is the same as running basis over every
+// shard's features at once.
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    fs::path stem(argv[1]);
+    Encoding encoding = ParseEncoding(argv[2]);
+    fs::path out_listing = fs::path(stem).replace_extension(".txt");
+
+    std::vector<fs::path> shard_listings(argv + 3, argv + argc);
+    for (const auto& f : shard_listings) {
+        fs::path stats_file = fs::path(f).replace_extension(".stats");
+        for (const auto& g : {f, stats_file}) {
+            if (!fs::exists(g)) {
+                std::cerr << "Could not find file " << g << std::endl;
+                exit(2);
+            }
+        }
+        if (fs::exists(out_listing) && fs::equivalent(f, out_listing)) {
+            std::cerr << "Shard " << f << " would be overwritten by the "
+                      << "merged listing." << std::endl;
+            exit(2);
+        }
+    }
+
+    /***************************************************************
+        Sum the statistics and concatenate the listings
+    ***************************************************************/
+    FeatureStats stats;
+    std::ofstream out(out_listing);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << out_listing << std::endl;
+        exit(1);
+    }
+
+    for (const auto& f : shard_listings) {
+        FeatureStats shard =
+            FeatureStats::Load(fs::path(f).replace_extension(".stats"));
+        if (shard.count() > 0) {
+            if (stats.count() == 0) stats = FeatureStats(shard.dims());
+            stats.Merge(shard);
+        }
+
+        std::ifstream in(f);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) out << line << "\n";
+        }
+    }
+    out.close();
+
+    if (stats.count() < 1) {
+        std::cerr << "No features to compute a basis from." << std::endl;
+        exit(1);
+    }
+
+    std::cout << out_listing << std::endl;
+    for (const auto& f : SaveBasis(stem, stats, encoding)) {
+        std::cout << f << std::endl;
+    }
+    return 0;
+}
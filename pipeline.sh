@@ -1,11 +1,21 @@
 # The complete classification pipline.
 
-# Usage: source pipeline.sh <partition>
-# Where <partition> is the folder created by `partition.py`
+# Usage: source pipeline.sh <partition> [encoding]
+# Where <partition> is the folder created by `partition.py` and [encoding] is
+# the storage encoding (text, fp16 or int8) for features and the basis. When an
+# encoding is given, results are written to <partition>/<encoding>.
+# Set AUGMENT=<copies> to add that many augmented copies of each training clip,
+# and BACKGROUNDS=<wavs.txt> to mix in background clips from that listing.
 
 out=$1
 train=$1/train_data
 test=$1/test_data
+encoding=${2:-text}
+
+if [ -n "$2" ]; then
+    out=$1/$2
+    mkdir -p $out
+fi
 
 dimensions=12
 
@@ -15,24 +25,34 @@ if [ -f "$out/confusion.txt" ]; then
 fi
 
 echo "Extracting features from training data."
-for f in $train/*.wav; do ./build/extract "$f" >> $out/train.txt; done
+printf '%s\n' $train/*.wav > $out/train_wav.txt
+./build/extract $out/train_wav.txt 0 $encoding >> $out/train.txt
 
 echo "Computing optimal basis."
-./build/basis $out/train.txt > /dev/null
+./build/basis $out/train.txt $encoding > /dev/null
+
+if [ -n "$AUGMENT" ]; then
+    echo "Adding augmented training data to the basis."
+    ./build/augment basis $out/train_wav.txt $AUGMENT 748 $out/train $encoding $BACKGROUNDS > /dev/null
+fi
 
 echo "Reducing dimensionality."
-./build/reduce $out/train.txt $out/train $dimensions >> $out/train.reduced
+./build/reduce $out/train.txt $out/train $dimensions $encoding >> $out/train.reduced
+
+if [ -n "$AUGMENT" ]; then
+    echo "Reducing augmented training data."
+    ./build/augment reduce $out/train_wav.txt $AUGMENT 748 $out/train $dimensions $encoding $BACKGROUNDS >> $out/train.reduced
+fi
 
 echo "Training SVM."
-./build/prep-svm $out/train.reduced
-./third-party/libsvm/svm-train $out/train.svm $out/model > /dev/null
+./build/classify train $out/train.reduced $out/model
 
 echo "Extracting features from test data."
-for f in $test/*.wav; do ./build/extract "$f" >> $out/test.txt; done
+printf '%s\n' $test/*.wav > $out/test_wav.txt
+./build/extract $out/test_wav.txt 0 $encoding >> $out/test.txt
 
 echo "Projecting test data onto basis."
-./build/reduce $out/test.txt $out/train $dimensions >> $out/test.reduced
+./build/reduce $out/test.txt $out/train $dimensions $encoding >> $out/test.reduced
 
 echo "Predicting with SVM."
-./build/prep-svm $out/test.reduced
-./third-party/libsvm/svm-predict $out/test.svm $out/model $out/confusion.txt
+./build/classify predict $out/test.reduced $out/model $out/confusion.txt
@@ -22,7 +22,7 @@ def plot_confusion(folder: Path):
     fig = plt.figure(f"Confusion Matrix for {folder}")
     ax = fig.add_axes(111)
 
-    expected_f = folder / "test.svm"
+    expected_f = folder / "test.reduced"
     confused_f = folder / "confusion.txt"
 
     for f in [expected_f, confused_f]:
@@ -32,8 +32,9 @@ def plot_confusion(folder: Path):
     with open(confused_f, "r") as f:
         confused = [int(i) for i in f.readlines()]
 
+    # The label is the first character of each reduced file's name.
     with open(expected_f, "r") as f:
-        expected = [int(i[0]) for i in f.readlines()]
+        expected = [int(Path(i.strip().strip('"')).name[0]) for i in f]
 
     assert len(confused) == len(expected)
 
@@ -2,8 +2,11 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
 
 namespace fs = std::filesystem;
 
@@ -30,18 +33,30 @@ int main(int argc, char* argv[]) {
                       << std::endl;
             exit(1);
         }
+    }
 
-        // assume the label is the first character
-        int label = f.stem().string()[0] - '0';
-
-        Eigen::ArrayXd feature = LoadCSV(f);
+    RunPipeline<std::pair<int, Eigen::ArrayXXd>, std::string>(
+        reduced_files,
+        [](const fs::path& f) {
+            // assume the label is the first character
+            int label = f.stem().string()[0] - '0';
+            return std::make_pair(label, LoadMatrix(f));
+        },
+        [](std::pair<int, Eigen::ArrayXXd> samples) {
+            const auto& [label, features] = samples;
 
-        out << label << " ";
-        for (int i = 0; i < feature.size(); i++) {
-            out << i + 1 << ":" << feature(i) << " ";
-        }
-        out << std::endl;
-    }
+            // One line per column, since a file may hold several samples.
+            std::ostringstream lines;
+            for (int c = 0; c < features.cols(); c++) {
+                lines << label << " ";
+                for (int i = 0; i < features.rows(); i++) {
+                    lines << i + 1 << ":" << features(i, c) << " ";
+                }
+                lines << "\n";
+            }
+            return lines.str();
+        },
+        [&](const fs::path&, std::string line) { out << line; });
 
     out.close();
 
@@ -0,0 +1,78 @@
+#include "quantize.hpp"
+
+#include <Eigen/Core>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+#include "fileio.hpp"
+
+namespace fs = std::filesystem;
+
+struct Report {
+    double bytes = 0;
+    double values = 0;
+    double max_error = 0;
+    double sum_sq_error = 0;
+    double sum_sq_value = 0;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: ./quantize <files.txt> <encoding?>" << std::endl;
+        exit(2);
+    }
+
+    std::vector<fs::path> files = ReadFileListing(argv[1]);
+
+    // Convert every file in place.
+    if (argc == 3) {
+        Encoding encoding = ParseEncoding(argv[2]);
+        for (const auto& f : files) {
+            SaveMatrix(f, LoadMatrix(f), encoding);
+            std::cout << f << std::endl;
+        }
+        return 0;
+    }
+
+    // Otherwise report the size and reconstruction error of each encoding.
+    const std::vector<Encoding> encodings = {
+        Encoding::kText, Encoding::kFloat64, Encoding::kFloat16,
+        Encoding::kInt8};
+    std::vector<Report> reports(encodings.size());
+
+    fs::path tmp = fs::path(argv[1]).replace_extension(".quantize.tmp");
+
+    for (const auto& f : files) {
+        Eigen::ArrayXXd original = LoadMatrix(f);
+
+        for (int e = 0; e < encodings.size(); e++) {
+            // Round trip through disk so the sizes are real.
+            SaveMatrix(tmp, original, encodings[e]);
+            Eigen::ArrayXXd decoded = LoadMatrix(tmp);
+
+            Report& r = reports[e];
+            r.bytes += fs::file_size(tmp);
+            r.values += original.size();
+            r.max_error =
+                std::max(r.max_error, (decoded - original).abs().maxCoeff());
+            r.sum_sq_error += (decoded - original).square().sum();
+            r.sum_sq_value += original.square().sum();
+        }
+    }
+    fs::remove(tmp);
+
+    std::cout << "encoding,bytes_per_value,max_abs_error,rms_error,"
+                 "relative_rms_error"
+              << std::endl;
+    for (int e = 0; e < encodings.size(); e++) {
+        const Report& r = reports[e];
+        std::cout << EncodingName(encodings[e]) << "," << r.bytes / r.values
+                  << "," << r.max_error << ","
+                  << std::sqrt(r.sum_sq_error / r.values) << ","
+                  << std::sqrt(r.sum_sq_error / r.sum_sq_value) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+# Compares the storage encodings on a partition.
+
+# Usage: bash quantize_report.sh <partition>
+# Runs the pipeline once per encoding, then prints the reconstruction error of
+# each encoding and the classification accuracy it leads to.
+
+partition=$1
+
+for encoding in text fp16 int8; do
+    if [ -f "$partition/$encoding/confusion.txt" ]; then
+        echo "Error: $partition/$encoding/confusion.txt already exists. Exiting."
+        exit 1
+    fi
+    mkdir -p $partition/$encoding
+done
+
+# Each encoding writes its own feature files (<stem>.fp16.feat and so on), so
+# the runs do not overwrite each other.
+bash pipeline.sh $partition text > $partition/text/pipeline.log
+
+echo "Features:"
+./build/quantize $partition/text/train.txt
+
+printf '%s\n' $partition/text/train.basis $partition/text/train.mean > $partition/text/model.txt
+echo "Basis and mean:"
+./build/quantize $partition/text/model.txt
+
+echo "Reduced:"
+./build/quantize $partition/text/train.reduced
+
+for encoding in fp16 int8; do
+    bash pipeline.sh $partition $encoding > $partition/$encoding/pipeline.log
+done
+
+echo "Accuracy:"
+for encoding in text fp16 int8; do
+    echo "$encoding: $(grep Accuracy $partition/$encoding/pipeline.log)"
+done
@@ -5,6 +5,8 @@
 #include <iostream>
 
 #include "fileio.hpp"
+#include "pipeline.hpp"
+#include "quantize.hpp"
 
 namespace fs = std::filesystem;
 
@@ -13,11 +15,13 @@ struct Args {
     fs::path basis_file;
     fs::path mean_file;
     int dims;
+    Encoding encoding = Encoding::kText;
 
-    const std::string USAGE = "Usage: ./reduce <feats.txt> <basis-stem> <dims>";
+    const std::string USAGE =
+        "Usage: ./reduce <feats.txt> <basis-stem> <dims> <encoding?>";
 
     Args(int argc, char* argv[]) {
-        if (argc != 4) {
+        if (argc < 4 || argc > 5) {
             std::cerr << USAGE << std::endl;
             exit(2);
         }
@@ -26,6 +30,9 @@ struct Args {
         basis_file = fs::path(argv[2]).replace_extension(".basis");
         mean_file = fs::path(argv[2]).replace_extension(".mean");
         dims = std::stoi(argv[3]);
+        if (argc == 5) {
+            encoding = ParseEncoding(argv[4]);
+        }
 
         Validate();
     }
@@ -50,27 +57,33 @@ private:
 int main(int argc, char* argv[]) {
     Args args(argc, argv);
 
-    Eigen::VectorXd mean = LoadCSV(args.mean_file);
-    Eigen::MatrixXd basis = LoadCSV(args.basis_file);
+    Eigen::VectorXd mean = LoadMatrix(args.mean_file);
+    // Kept in its stored encoding. Dequantized inside the projection.
+    QuantizedMatrix basis = LoadQuantized(args.basis_file);
     assert(mean.size() == basis.rows());
     assert(basis.rows() == basis.cols());
 
-    for (const auto& f : args.feature_files) {
-        Eigen::VectorXd feature = FlattenFeature(LoadCSV(f));
-
-        assert(feature.size() == mean.size());
-
-        Eigen::VectorXd reduced =
-            basis.rightCols(args.dims).transpose() * (feature - mean);
-
-        // basis has largest eigenvalues on right. reverse so most important dim
-        // is first
-        reduced.reverseInPlace();
-
-        fs::path reduced_file = f;
-        reduced_file.replace_extension(".reduced");
-        SaveCSV(reduced_file, reduced);
-        std::cout << reduced_file << std::endl;
-    }
+    RunPipeline<Eigen::VectorXd, Eigen::VectorXd>(
+        args.feature_files,
+        [](const fs::path& f) -> Eigen::VectorXd {
+            return FlattenFeature(LoadMatrix(f));
+        },
+        [&](Eigen::VectorXd feature) -> Eigen::VectorXd {
+            assert(feature.size() == mean.size());
+
+            Eigen::VectorXd reduced = basis.TransposeProduct(
+                feature - mean, basis.cols() - args.dims, args.dims);
+
+            // basis has largest eigenvalues on right. reverse so most
+            // important dim is first
+            reduced.reverseInPlace();
+            return reduced;
+        },
+        [&](const fs::path& f, Eigen::VectorXd reduced) {
+            fs::path reduced_file = f;
+            reduced_file.replace_extension(".reduced");
+            SaveMatrix(reduced_file, reduced, args.encoding);
+            std::cout << reduced_file << std::endl;
+        });
     return 0;
 }
@@ -0,0 +1,568 @@
+#include <unistd.h>
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "audio.hpp"
+#include "bundle.hpp"
+#include "cascade.hpp"
+#include "classify.hpp"
+#include "extract.hpp"
+#include "fileio.hpp"
+#include "quantize.hpp"
+#include "reduce.hpp"
+#include "scan.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+
+namespace fs = std::filesystem;
+
+const std::string USAGE =
+    "Usage: ./regress <record|check> <golden-dir> <wavs.txt?>";
+
+// Largest allowed difference from the golden outputs at each stage.
+const double kFeatureTolerance = 1e-9;     // log10 power
+const double kEigenvalueTolerance = 1e-9;  // relative to the largest
+const double kBasisTolerance = 1e-6;       // leading eigenvectors, up to sign
+const double kReducedTolerance = 1e-6;
+const double kTextTolerance = 1e-12;  // 16 significant digits
+
+const int kDims = 12;
+
+struct Dataset {
+    std::string name;
+    int sample_rate = 8000;
+    std::vector<Eigen::ArrayXd> clips;
+    std::vector<int> labels;
+    std::vector<bool> is_test;
+};
+
+// Deterministic digit-like clips: a class dependent pitch with two harmonics
+// under a smooth envelope, plus noise. Uses raw mt19937 output since the
+// standard distributions are not reproducible across standard libraries.
+Dataset Synthesize(int clips_per_class) {
+    constexpr double PI = 3.14159265358979323;
+
+    Dataset d;
+    d.name = "synthetic";
+    std::mt19937 rng(748);
+    auto uniform = [&] { return rng() / 4294967296.; };
+
+    for (int label = 0; label < 10; label++) {
+        for (int k = 0; k < clips_per_class; k++) {
+            int n = d.sample_rate * (0.35 + 0.2 * uniform());
+            double f0 = 200 + 60 * label + 80 * (uniform() - 0.5);
+            double f1 = f0 * (2.1 + 0.05 * label);
+
+            Eigen::ArrayXd clip(n);
+            for (int t = 0; t < n; t++) {
+                double env = std::sin(PI * t / n);
+                double time = static_cast<double>(t) / d.sample_rate;
+                clip(t) = env * (0.6 * std::sin(2 * PI * f0 * time) +
+                                 0.3 * std::sin(2 * PI * f1 * time)) +
+                          1.5 * (uniform() - 0.5);
+            }
+
+            d.clips.push_back(clip);
+            d.labels.push_back(label);
+            d.is_test.push_back(k % 5 == 4);
+        }
+    }
+    return d;
+}
+
+// Labels are the first character of each file name, as in prep-svm.
+Dataset LoadListing(const fs::path& listing) {
+    Dataset d;
+    d.name = "dataset";
+
+    std::vector<fs::path> files = ReadFileListing(listing);
+    for (int i = 0; i < files.size(); i++) {
+        AudioFile aud(files[i].string());
+        d.sample_rate = aud.sample_rate;
+        d.clips.push_back(aud.data);
+        d.labels.push_back(files[i].stem().string()[0] - '0');
+        d.is_test.push_back(i % 5 == 4);
+    }
+    return d;
+}
+
+struct Outputs {
+    Eigen::ArrayXXd features;  // one flattened feature per row
+    Eigen::ArrayXd eigenvalues;
+    Eigen::ArrayXXd basis;
+    Eigen::ArrayXXd mean;
+    Eigen::ArrayXXd reduced;  // one reduced feature per row
+};
+
+Eigen::ArrayXXd ExtractAll(const Dataset& d, bool fast_log = false) {
+    ExtractorWorkspace workspace;
+    workspace.SetFastLog(fast_log);
+    Eigen::ArrayXXd features(d.clips.size(), kNumFilters * kNumPeriods);
+    for (int i = 0; i < d.clips.size(); i++) {
+        features.row(i) =
+            FlattenFeature(workspace.Extract(d.clips[i], d.sample_rate));
+    }
+    return features;
+}
+
+// The basis tool's statistics and SaveBasis, trained on the training clips
+// only. The files are written to `scratch` and read back.
+void ComputeBasis(const Dataset& d, const fs::path& scratch, Outputs& out) {
+    FeatureStats stats(out.features.cols());
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (!d.is_test[i]) stats.Add(out.features.row(i).matrix());
+    }
+
+    fs::path stem = scratch / d.name;
+    SaveBasis(stem, stats, Encoding::kFloat64);
+    out.eigenvalues = LoadMatrix(fs::path(stem).replace_extension(".scree"));
+    out.basis = LoadMatrix(fs::path(stem).replace_extension(".basis"));
+    out.mean = LoadMatrix(fs::path(stem).replace_extension(".mean"));
+}
+
+// Same projection as reduce, with the basis in the given encoding.
+Eigen::ArrayXXd Reduce(const Eigen::ArrayXXd& features,
+                       const Eigen::ArrayXXd& basis,
+                       const Eigen::ArrayXXd& mean, Encoding encoding,
+                       int dims) {
+    QuantizedMatrix q = QuantizedMatrix::Encode(basis, encoding);
+    Eigen::VectorXd m = mean;
+
+    Eigen::ArrayXXd reduced(features.rows(), dims);
+    for (int i = 0; i < features.rows(); i++) {
+        Eigen::VectorXd r = q.TransposeProduct(
+            features.row(i).transpose().matrix() - m, q.cols() - dims, dims);
+        reduced.row(i) = r.reverse();
+    }
+    return reduced;
+}
+
+// Trains the same RBF SVM as classify on the training clips and scores it on
+// the test clips.
+double Accuracy(const Dataset& d, const Eigen::ArrayXXd& reduced) {
+    std::vector<int> train_rows;
+    std::vector<int> test_rows;
+    std::vector<int> train_labels;
+    for (int i = 0; i < reduced.rows(); i++) {
+        if (d.is_test[i]) {
+            test_rows.push_back(i);
+        } else {
+            train_rows.push_back(i);
+            train_labels.push_back(d.labels[i]);
+        }
+    }
+
+    Eigen::MatrixXd train = reduced(train_rows, Eigen::all).matrix();
+    Eigen::MatrixXd test = reduced(test_rows, Eigen::all).matrix();
+    SvmModel model = SvmModel::Train(train, train_labels);
+    std::vector<int> predictions = model.Predict(test);
+
+    int correct = 0;
+    for (int i = 0; i < test_rows.size(); i++) {
+        correct += predictions[i] == d.labels[test_rows[i]];
+    }
+    return static_cast<double>(correct) / test_rows.size();
+}
+
+// Features saved as text and read back with LoadCSV, the path every tool
+// takes by default.
+bool CheckTextRoundTrip(const Dataset& d, const Eigen::ArrayXXd& features,
+                        const fs::path& scratch) {
+    fs::path f = scratch / (d.name + ".feat");
+    SaveMatrix(f, features, Encoding::kText);
+    Eigen::ArrayXXd loaded = LoadCSV(f);
+
+    double error = std::numeric_limits<double>::infinity();
+    if (loaded.rows() == features.rows() && loaded.cols() == features.cols()) {
+        error = (loaded - features).abs().maxCoeff();
+    }
+
+    bool ok = error <= kTextTolerance;
+    std::cout << d.name << " text," << error << "," << kTextTolerance << ","
+              << (ok ? "ok" : "FAIL") << std::endl;
+    return ok;
+}
+
+// Scans one long recording made of the clips and compares every window with
+// extracting it alone. The clips get louder and then quieter by 60 dB so
+// quiet windows follow loud ones, which is where running totals over the
+// whole recording lose precision.
+bool CheckScan(const Dataset& d) {
+    const int kClips = 12;
+    const int kWindowFrames = 50;
+    const int kStepFrames = 7;
+
+    int n = std::min<int>(kClips, d.clips.size());
+    int length = 0;
+    for (int i = 0; i < n; i++) length += d.clips[i].size();
+
+    Eigen::ArrayXd recording(length);
+    int offset = 0;
+    for (int i = 0; i < n; i++) {
+        double gain = std::pow(10., 3 * std::cos(3.14159265358979 * i / n));
+        recording.segment(offset, d.clips[i].size()) = gain * d.clips[i];
+        offset += d.clips[i].size();
+    }
+
+    RecordingScanner scanner(recording, d.sample_rate);
+    scanner.SetFastLog(false);
+    ExtractorWorkspace workspace;
+    workspace.SetFastLog(false);
+
+    double worst = 0;
+    for (int s = 0; s + kWindowFrames <= scanner.num_frames();
+         s += kStepFrames) {
+        auto [start, end] = scanner.Span(s, kWindowFrames);
+        const Eigen::ArrayXXd& alone = workspace.Extract(
+            recording.segment(start, end - start), d.sample_rate);
+        worst = std::max(
+            worst,
+            (scanner.Extract(s, kWindowFrames) - alone).abs().maxCoeff());
+    }
+
+    bool ok = worst <= kFeatureTolerance;
+    std::cout << d.name << " scan," << worst << "," << kFeatureTolerance << ","
+              << (ok ? "ok" : "FAIL") << std::endl;
+    return ok;
+}
+
+// Trains a cascade on the training clips and checks that it is at least as
+// accurate on the test clips as its last stage alone.
+bool CheckCascade(const Dataset& d, const Outputs& out) {
+    std::vector<int> train_rows;
+    std::vector<int> train_labels;
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (!d.is_test[i]) {
+            train_rows.push_back(i);
+            train_labels.push_back(d.labels[i]);
+        }
+    }
+
+    Eigen::MatrixXd train = out.reduced(train_rows, Eigen::all).matrix();
+    Cascade cascade =
+        Cascade::Train(train, train_labels, {kDims / 4, kDims / 2, kDims});
+    const Cascade::Stage& last = cascade.stages().back();
+
+    QuantizedMatrix basis =
+        QuantizedMatrix::Encode(out.basis, Encoding::kFloat64);
+    Eigen::VectorXd mean = out.mean;
+
+    int n = 0;
+    int cascade_correct = 0;
+    int last_correct = 0;
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (!d.is_test[i]) continue;
+        Eigen::VectorXd centered =
+            out.features.row(i).transpose().matrix() - mean;
+        Eigen::VectorXd reduced = out.reduced.row(i).transpose().matrix();
+
+        n++;
+        cascade_correct +=
+            cascade.Predict(centered, basis).label == d.labels[i];
+        last_correct += last.model.Predict(reduced) == d.labels[i];
+    }
+
+    // Accuracy lost by exiting early.
+    double loss = static_cast<double>(last_correct - cascade_correct) / n;
+    bool ok = loss <= 0;
+    std::cout << d.name << " cascade," << loss << ",0,"
+              << (ok ? "ok" : "FAIL") << std::endl;
+    return ok;
+}
+
+// Saves the basis and an SVM trained on the training clips as a bundle, and
+// checks that the reopened bundle reduces and classifies the test clips as
+// reduce and the SVM do. Also checks that a truncated bundle, one of another
+// version and one with an unsupported kernel are rejected.
+bool CheckBundle(const Dataset& d, const Outputs& out,
+                 const fs::path& scratch) {
+    std::vector<int> train_rows;
+    std::vector<int> train_labels;
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (!d.is_test[i]) {
+            train_rows.push_back(i);
+            train_labels.push_back(d.labels[i]);
+        }
+    }
+    Eigen::MatrixXd train = out.reduced(train_rows, Eigen::all).matrix();
+    SvmModel model = SvmModel::Train(train, train_labels);
+
+    fs::path f = scratch / (d.name + ".bundle");
+    ModelBundle::Save(f, FeatureConfig(), d.sample_rate, out.basis.matrix(),
+                      out.mean.matrix(), kDims, model);
+    ModelBundle bundle(f);
+
+    ExtractorWorkspace workspace;
+    workspace.SetFastLog(false);
+    double reduce_error = 0;
+    int mismatches = 0;
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (!d.is_test[i]) continue;
+        Eigen::VectorXd reduced = out.reduced.row(i).transpose().matrix();
+        Eigen::VectorXd bundled =
+            bundle.Reduce(workspace.Extract(d.clips[i], d.sample_rate));
+        reduce_error =
+            std::max(reduce_error, (bundled - reduced).cwiseAbs().maxCoeff());
+
+        int label = model.Predict(reduced);
+        mismatches += bundle.Predict(reduced) != label;
+        mismatches +=
+            bundle.Classify(d.clips[i], d.sample_rate, workspace) != label;
+    }
+
+    // Each corruption of the saved bytes must be rejected on open.
+    std::string bytes;
+    {
+        std::ifstream in(f, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        bytes = ss.str();
+    }
+    auto poke = [&](size_t offset, int32_t value) {
+        std::string b = bytes;
+        std::memcpy(b.data() + offset, &value, sizeof(value));
+        return b;
+    };
+    const std::vector<std::string> corrupt = {
+        bytes.substr(0, bytes.size() - 8),
+        poke(offsetof(ModelBundle::Header, version), kBundleVersion + 1),
+        poke(offsetof(ModelBundle::Header, kernel), POLY),
+    };
+    int accepted = 0;
+    for (const auto& b : corrupt) {
+        std::ofstream(f, std::ios::binary).write(b.data(), b.size());
+        try {
+            ModelBundle reopened(f);
+            accepted++;
+        } catch (const std::runtime_error&) {
+        }
+    }
+
+    bool ok = true;
+    auto report = [&](const std::string& stage, double error, double tol) {
+        bool stage_ok = error <= tol;
+        std::cout << d.name << " " << stage << "," << error << "," << tol
+                  << "," << (stage_ok ? "ok" : "FAIL") << std::endl;
+        ok &= stage_ok;
+    };
+    report("bundle reduced", reduce_error, kReducedTolerance);
+    report("bundle predictions", mismatches, 0);
+    report("bundle corrupt", accepted, 0);
+    return ok;
+}
+
+// Largest difference between matching columns, allowing each to flip sign.
+double ColumnDifferenceUpToSign(const Eigen::ArrayXXd& a,
+                                const Eigen::ArrayXXd& b, int first_col) {
+    double worst = 0;
+    for (int c = first_col; c < a.cols(); c++) {
+        double same = (a.col(c) - b.col(c)).abs().maxCoeff();
+        double flipped = (a.col(c) + b.col(c)).abs().maxCoeff();
+        worst = std::max(worst, std::min(same, flipped));
+    }
+    return worst;
+}
+
+// The part of the outputs kept as golden files, small enough to commit: the
+// features of the test clips and the leading kDims basis vectors. The
+// training features are still covered through the eigenvalues, basis and
+// reduced features.
+Outputs GoldenSubset(const Dataset& d, const Outputs& out) {
+    std::vector<int> test_rows;
+    for (int i = 0; i < d.clips.size(); i++) {
+        if (d.is_test[i]) test_rows.push_back(i);
+    }
+
+    Outputs golden = out;
+    golden.features = out.features(test_rows, Eigen::all);
+    golden.basis = out.basis.rightCols(kDims);
+    return golden;
+}
+
+// Compares each stage to the golden outputs. Returns false if any stage is
+// outside its tolerance.
+bool Check(const Outputs& out, const fs::path& stem) {
+    auto report = [](const std::string& stage, double error, double tol) {
+        bool ok = error <= tol;
+        std::cout << stage << "," << error << "," << tol << ","
+                  << (ok ? "ok" : "FAIL") << std::endl;
+        return ok;
+    };
+
+    auto golden = [&](const std::string& ext) {
+        fs::path f = fs::path(stem).replace_extension(ext);
+        if (!fs::exists(f)) {
+            std::cerr << "Could not find golden output " << f
+                      << ". Run ./regress record first." << std::endl;
+            exit(2);
+        }
+        return LoadMatrix(f);
+    };
+
+    Eigen::ArrayXXd features = golden(".feat");
+    Eigen::ArrayXXd eigenvalues = golden(".scree");
+    Eigen::ArrayXXd basis = golden(".basis");
+    Eigen::ArrayXXd reduced = golden(".reduced");
+
+    if (features.rows() != out.features.rows() ||
+        features.cols() != out.features.cols() ||
+        basis.rows() != out.basis.rows() || basis.cols() != out.basis.cols()) {
+        std::cerr << "Golden outputs for " << stem
+                  << " have a different shape." << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    ok &= report(stem.stem().string() + " features",
+                 (features - out.features).abs().maxCoeff(), kFeatureTolerance);
+    ok &= report(stem.stem().string() + " eigenvalues",
+                 (eigenvalues - out.eigenvalues).abs().maxCoeff() /
+                     eigenvalues.abs().maxCoeff(),
+                 kEigenvalueTolerance);
+    ok &= report(stem.stem().string() + " basis",
+                 ColumnDifferenceUpToSign(basis, out.basis, 0),
+                 kBasisTolerance);
+    ok &= report(stem.stem().string() + " reduced",
+                 ColumnDifferenceUpToSign(reduced, out.reduced, 0),
+                 kReducedTolerance);
+    return ok;
+}
+
+void Record(const Outputs& out, const fs::path& stem) {
+    auto save = [&](const std::string& ext, const Eigen::ArrayXXd& values) {
+        fs::path f = fs::path(stem).replace_extension(ext);
+        SaveMatrix(f, values, Encoding::kFloat64);
+        std::cout << f << std::endl;
+    };
+    save(".feat", out.features);
+    save(".scree", out.eigenvalues);
+    save(".basis", out.basis);
+    save(".reduced", out.reduced);
+}
+
+// A selectable speed/accuracy trade-off. Each is timed from features to
+// predictions. Modes with fast_log also re-extract the features.
+struct Mode {
+    std::string name;
+    Encoding encoding;
+    int dims;
+    bool fast_log = false;
+};
+
+void CompareModes(const Dataset& d, const Outputs& out,
+                  double extraction_sec) {
+    const std::vector<Mode> modes = {
+        {"exact", Encoding::kFloat64, kDims},
+        {"fp16", Encoding::kFloat16, kDims},
+        {"int8", Encoding::kInt8, kDims},
+        {"truncated-pca", Encoding::kFloat64, kDims / 2},
+        {"fastlog", Encoding::kFloat64, kDims, true},
+    };
+
+    double exact_accuracy = 0;
+    std::cout << "dataset,mode,accuracy,accuracy_change,extract_sec,"
+              << "reduce_sec" << std::endl;
+    for (const auto& mode : modes) {
+        double extract_sec = extraction_sec;
+        Eigen::ArrayXXd extracted = out.features;
+        if (mode.fast_log) {
+            auto start = std::chrono::steady_clock::now();
+            extracted = ExtractAll(d, true);
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            extract_sec = elapsed.count();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        // Storage encodings apply to the saved features as well as the basis.
+        Eigen::ArrayXXd features =
+            QuantizedMatrix::Encode(extracted, mode.encoding).Decode();
+        Eigen::ArrayXXd reduced =
+            Reduce(features, out.basis, out.mean, mode.encoding, mode.dims);
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        double accuracy = Accuracy(d, reduced);
+        if (mode.name == "exact") exact_accuracy = accuracy;
+
+        std::cout << d.name << "," << mode.name << "," << accuracy << ","
+                  << accuracy - exact_accuracy << "," << extract_sec << ","
+                  << elapsed.count() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4) {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    std::string command = argv[1];
+    if (command != "record" && command != "check") {
+        std::cerr << USAGE << std::endl;
+        exit(2);
+    }
+
+    fs::path dir(argv[2]);
+    fs::create_directories(dir);
+
+    // Intermediate files go here rather than next to the golden outputs.
+    fs::path scratch = fs::temp_directory_path() /
+                       ("regress-" + std::to_string(getpid()));
+    fs::create_directories(scratch);
+
+    std::vector<Dataset> datasets = {Synthesize(20)};
+    if (argc == 4) {
+        datasets.push_back(LoadListing(argv[3]));
+    }
+
+    // Which kernels are under test, e.g. when PROJ748_SIMD lowers the level.
+    std::cout << "simd," << SimdLevelName(ActiveSimdLevel()) << std::endl;
+
+    bool ok = true;
+    for (const auto& d : datasets) {
+        Outputs out;
+
+        auto start = std::chrono::steady_clock::now();
+        out.features = ExtractAll(d);
+        std::chrono::duration<double> extraction =
+            std::chrono::steady_clock::now() - start;
+
+        ComputeBasis(d, scratch, out);
+        out.reduced = Reduce(out.features, out.basis, out.mean,
+                             Encoding::kFloat64, kDims);
+
+        fs::path stem = dir / d.name;
+        if (command == "record") {
+            Record(GoldenSubset(d, out), stem);
+        } else {
+            ok &= Check(GoldenSubset(d, out), stem);
+        }
+
+        ok &= CheckTextRoundTrip(d, out.features, scratch);
+        ok &= CheckScan(d);
+        ok &= CheckCascade(d, out);
+        ok &= CheckBundle(d, out, scratch);
+        CompareModes(d, out, extraction.count());
+    }
+
+    fs::remove_all(scratch);
+    return ok ? 0 : 1;
+}
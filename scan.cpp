@@ -0,0 +1,139 @@
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "audio.hpp"
+#include "extract.hpp"
+#include "quantize.hpp"
+#include "reduce.hpp"
+#include "scan.hpp"
+
+namespace fs = std::filesystem;
+
+struct Args {
+    fs::path audio_file;
+    double window_sec;
+    double step_sec;
+    fs::path basis_file;
+    fs::path mean_file;
+    int dims = 0;
+
+    const std::string USAGE =
+        "Usage: ./scan <filename> <window-sec> <step-sec> <basis-stem?> "
+        "<dims?>";
+
+    Args(int argc, char* argv[]) {
+        if (argc != 4 && argc != 6) {
+            std::cerr << USAGE << std::endl;
+            exit(2);
+        }
+
+        audio_file = argv[1];
+        window_sec = std::stod(argv[2]);
+        step_sec = std::stod(argv[3]);
+        if (argc == 6) {
+            basis_file = fs::path(argv[4]).replace_extension(".basis");
+            mean_file = fs::path(argv[4]).replace_extension(".mean");
+            dims = std::stoi(argv[5]);
+        }
+
+        Validate();
+    }
+
+private:
+    void Validate() {
+        if (window_sec <= 0 || step_sec <= 0) {
+            std::cerr << "Window and step must be positive." << std::endl;
+            exit(2);
+        }
+
+        if (basis_file.empty()) return;
+
+        for (const auto& f : {basis_file, mean_file}) {
+            if (!fs::exists(f)) {
+                std::cerr << "Could not find file " << f << std::endl;
+                exit(2);
+            }
+        }
+
+        if (dims <= 0) {
+            std::cerr << "Dimensions (" << dims << ") must be positive."
+                      << std::endl;
+            exit(2);
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    Args args(argc, argv);
+
+    AudioFile aud(args.audio_file.string());
+
+    int hop = HopSize(aud.sample_rate);
+    int fftn = WindowSize(aud.sample_rate);
+    if (aud.data.size() < fftn) {
+        std::cerr << args.audio_file << " is shorter than one frame."
+                  << std::endl;
+        exit(1);
+    }
+
+    /***************************************************************
+        Mel power of every frame
+    ***************************************************************/
+    RecordingScanner scanner(aud.data, aud.sample_rate);
+    int num_frames = scanner.num_frames();
+
+    /***************************************************************
+        Window positions
+    ***************************************************************/
+    // A window of W frames covers (W - 1) * hop + fftn samples.
+    int window_frames = std::max<int>(
+        1, std::round((args.window_sec * aud.sample_rate - fftn) / hop) + 1);
+    int step_frames =
+        std::max<int>(1, std::round(args.step_sec * aud.sample_rate / hop));
+    window_frames = std::min(window_frames, num_frames);
+
+    if (window_frames < kNumPeriods) {
+        std::cerr << "Window must span at least " << kNumPeriods << " frames."
+                  << std::endl;
+        exit(2);
+    }
+
+    Eigen::VectorXd mean;
+    QuantizedMatrix basis;
+    if (args.dims > 0) {
+        mean = LoadMatrix(args.mean_file);
+        basis = LoadQuantized(args.basis_file);
+        assert(mean.size() == basis.rows());
+    }
+
+    /***************************************************************
+        Pool each window
+    ***************************************************************/
+    // One line per window: start and end in seconds, then the flattened
+    // feature (or the reduced feature if a basis was given).
+    auto fmt = Eigen::IOFormat(Eigen::FullPrecision, Eigen::DontAlignCols, ",",
+                               ",");
+
+    for (int s = 0; s + window_frames <= num_frames; s += step_frames) {
+        auto [start, end] = scanner.Span(s, window_frames);
+        Eigen::VectorXd feature =
+            FlattenFeature(scanner.Extract(s, window_frames));
+
+        if (args.dims > 0) {
+            feature = basis.TransposeProduct(feature - mean,
+                                             basis.cols() - args.dims,
+                                             args.dims);
+            feature.reverseInPlace();
+        }
+
+        std::cout << static_cast<double>(start) / aud.sample_rate << ","
+                  << static_cast<double>(end) / aud.sample_rate << ","
+                  << feature.transpose().format(fmt) << "\n";
+    }
+
+    return 0;
+}
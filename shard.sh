@@ -0,0 +1,38 @@
+# Extracts the training features and computes the basis with several shard
+# processes, the same way it would run across machines.
+
+# Usage: bash shard.sh <partition> <shards> [encoding]
+# Where <partition> is the folder created by `partition.py`. Each shard
+# extracts its hash-partitioned share of the training listing and saves
+# partial statistics. `merge` then combines them into <partition>/train.basis,
+# .mean, .scree, .stats and the full listing <partition>/train.txt, which
+# `reduce` and the rest of pipeline.sh use as usual.
+
+out=$1
+train=$1/train_data
+shards=$2
+encoding=${3:-text}
+
+threads=$(( $(nproc) / shards ))
+if [ $threads -lt 1 ]; then
+    threads=1
+fi
+
+echo "Extracting features from training data with $shards shards."
+printf '%s\n' $train/*.wav > $out/train_wav.txt
+
+pids=()
+for ((k = 0; k < shards; k++)); do
+    PROJ748_THREADS=$threads ./build/extract --shard $k/$shards $out/train_wav.txt 0 $encoding > /dev/null &
+    pids+=($!)
+done
+
+for pid in ${pids[@]}; do
+    if ! wait $pid; then
+        echo "Error: a shard failed. Exiting."
+        exit 1
+    fi
+done
+
+echo "Merging shards."
+./build/merge $out/train $encoding $(for ((k = 0; k < shards; k++)); do echo $out/train_wav.shard${k}of$shards.txt; done) > /dev/null
@@ -1,17 +1,121 @@
 #include "audio.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <stdexcept>
 
+#include "fileio.hpp"
 #include "sndfile.hh"
 
-AudioFile::AudioFile(std::string filename) {
+namespace {
+void WarnMultichannel(const std::string& filename, int num_chn) {
+    if (num_chn > 1) {
+        std::cout << filename
+                  << " has more than 1 channel. Only the first "
+                     "will be kept."
+                  << std::endl;
+    }
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint16_t ReadU16(const uint8_t* p) {
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Fast path for 16-bit PCM WAV, which is nearly all of the dataset. Samples
+// are converted straight from the mapped file into `data`, keeping only the
+// first channel, with the same scaling as libsndfile (1 / 32768). Returns
+// false for anything else so the caller can fall back to libsndfile.
+bool ReadPcm16Wav(const std::string& filename, int& sample_rate,
+                  Eigen::ArrayXd& data) {
+    // WAV is little-endian and the samples are read in place.
+    if constexpr (std::endian::native != std::endian::little) return false;
+
+    MappedFile file(filename, /*sequential=*/true);
+    const uint8_t* bytes = file.data();
+    const size_t size = file.size();
+    if (!bytes || size < 12 || std::memcmp(bytes, "RIFF", 4) != 0 ||
+        std::memcmp(bytes + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    int num_chn = 0;
+    const uint8_t* samples = nullptr;
+    size_t num_bytes = 0;
+
+    // Chunks are padded to an even length.
+    for (size_t pos = 12; pos + 8 <= size;) {
+        const uint8_t* chunk = bytes + pos;
+        size_t chunk_size = ReadU32(chunk + 4);
+        size_t available = std::min(chunk_size, size - pos - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (available < 16) return false;
+            uint16_t format = ReadU16(chunk + 8);
+            num_chn = ReadU16(chunk + 10);
+            sample_rate = ReadU32(chunk + 12);
+            uint16_t block_align = ReadU16(chunk + 20);
+            uint16_t bits = ReadU16(chunk + 22);
+
+            const uint16_t kPcm = 1;
+            if (format != kPcm || bits != 16 || num_chn < 1 ||
+                block_align != 2 * num_chn) {
+                return false;
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            // Streamed files may not have the final size in the header, so
+            // take whatever is present.
+            samples = chunk + 8;
+            num_bytes = available;
+            break;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (num_chn == 0 || !samples || (samples - bytes) % 2 != 0) return false;
+
+    WarnMultichannel(filename, num_chn);
+
+    const Eigen::Index num_frames = num_bytes / (2 * num_chn);
+    const auto* pcm = reinterpret_cast<const int16_t*>(samples);
+    if (num_chn == 1) {
+        data = Eigen::Map<const Eigen::Array<int16_t, Eigen::Dynamic, 1>>(
+                   pcm, num_frames)
+                   .cast<double>() *
+               (1. / 32768);
+    } else {
+        // Frames are interleaved, so the first channel is every num_chn-th
+        // sample.
+        data = Eigen::Map<const Eigen::Array<int16_t, Eigen::Dynamic, 1>, 0,
+                          Eigen::InnerStride<>>(pcm, num_frames,
+                                                Eigen::InnerStride<>(num_chn))
+                   .cast<double>() *
+               (1. / 32768);
+    }
+    return true;
+}
+}  // namespace
+
+AudioFile::AudioFile(const std::string& filename) {
     namespace fs = std::filesystem;
 
     if (!fs::exists(filename)) {
         throw std::runtime_error("Audio file " + filename + " does not exist.");
     }
 
+    if (ReadPcm16Wav(filename, sample_rate, data)) return;
+
     SndfileHandle f(filename);
     if (f.error()) {
         throw std::runtime_error("Failed to open " + filename + ".");
@@ -20,19 +124,19 @@ AudioFile::AudioFile(std::string filename) {
     size_t num_chn = f.channels();
     size_t num_frames = f.frames();
 
-    if (num_chn > 1) {
-        std::cout << filename
-                  << " has more than 1 channel. Only the first "
-                     "will be kept."
-                  << std::endl;
-    }
+    WarnMultichannel(filename, num_chn);
 
     sample_rate = f.samplerate();
-    double* buffer = new double[num_chn * num_frames]();
-    f.readf(buffer, num_frames);
 
-    Eigen::ArrayXXd all_channels =
-        Eigen::Map<Eigen::ArrayXXd>(buffer, num_chn, num_frames);
+    if (num_chn == 1) {
+        data.resize(num_frames);
+        f.readf(data.data(), num_frames);
+        return;
+    }
+
+    // Frames are interleaved, so each column holds one frame.
+    Eigen::ArrayXXd all_channels(num_chn, num_frames);
+    f.readf(all_channels.data(), num_frames);
 
     data = all_channels.row(0);
-}
\ No newline at end of file
+}
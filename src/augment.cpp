@@ -0,0 +1,140 @@
+#include "augment.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+// Mixes the seed, clip and copy into one well distributed seed.
+uint64_t SplitMix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Uses raw mt19937_64 output since the standard distributions are not
+// reproducible across standard libraries.
+class Random {
+public:
+    explicit Random(uint64_t seed) : rng_(seed) {}
+
+    // In [0, 1).
+    double Uniform() { return (rng_() >> 11) * 0x1.0p-53; }
+
+    double Uniform(double lo, double hi) { return lo + (hi - lo) * Uniform(); }
+
+    // Box-Muller.
+    double Gaussian() {
+        constexpr double PI = 3.14159265358979323;
+        double u1 = 1 - Uniform();  // (0, 1] so the log is finite
+        double u2 = Uniform();
+        return std::sqrt(-2 * std::log(u1)) * std::cos(2 * PI * u2);
+    }
+
+private:
+    std::mt19937_64 rng_;
+};
+
+double Power(const Eigen::ArrayXd& x) {
+    return x.size() ? x.square().mean() : 0;
+}
+}  // namespace
+
+Eigen::ArrayXd ChangeSpeed(const Eigen::ArrayXd& clip, double factor) {
+    if (clip.size() < 2) return clip;
+
+    int n = std::max<int>(1, std::floor((clip.size() - 1) / factor) + 1);
+    Eigen::ArrayXd out(n);
+    for (int i = 0; i < n; i++) {
+        double t = i * factor;
+        int j = std::min<int>(t, clip.size() - 2);
+        double frac = t - j;
+        out(i) = (1 - frac) * clip(j) + frac * clip(j + 1);
+    }
+    return out;
+}
+
+Augmenter::Augmenter(AugmentOptions options,
+                     std::vector<Eigen::ArrayXd> backgrounds)
+    : options_(options), backgrounds_(std::move(backgrounds)) {}
+
+Eigen::ArrayXd Augmenter::Apply(const Eigen::ArrayXd& clip, int sample_rate,
+                                uint64_t clip_id, int copy) const {
+    const AugmentOptions& o = options_;
+    Random random(SplitMix64(o.seed ^ SplitMix64(clip_id ^ SplitMix64(copy))));
+
+    // Every draw is made whether or not its transform is enabled, so
+    // changing one range does not reshuffle the others.
+    double speed = 1 + random.Uniform(-o.max_speed_change, o.max_speed_change);
+    double shift_sec = random.Uniform(-o.max_shift_sec, o.max_shift_sec);
+    bool use_background = random.Uniform() < o.background_probability;
+    double background_pick = random.Uniform();
+    double background_offset = random.Uniform();
+    double background_snr_db =
+        random.Uniform(o.min_background_snr_db, o.max_background_snr_db);
+    bool use_noise = random.Uniform() < o.noise_probability;
+    double noise_snr_db =
+        random.Uniform(o.min_noise_snr_db, o.max_noise_snr_db);
+    double gain_db = random.Uniform(-o.max_gain_db, o.max_gain_db);
+
+    /***************************************************************
+        Speed
+    ***************************************************************/
+    Eigen::ArrayXd x = speed == 1 ? clip : ChangeSpeed(clip, speed);
+
+    // Reference power for the SNRs, before silence is added.
+    const double signal_power = Power(x);
+
+    /***************************************************************
+        Shift
+    ***************************************************************/
+    int shift = std::round(shift_sec * sample_rate);
+    if (shift != 0) {
+        Eigen::ArrayXd shifted =
+            Eigen::ArrayXd::Zero(x.size() + std::abs(shift));
+        shifted.segment(std::max(shift, 0), x.size()) = x;
+        x = std::move(shifted);
+    }
+
+    /***************************************************************
+        Background
+    ***************************************************************/
+    if (use_background && !backgrounds_.empty()) {
+        size_t pick = std::min<size_t>(background_pick * backgrounds_.size(),
+                                       backgrounds_.size() - 1);
+        const Eigen::ArrayXd& bg = backgrounds_[pick];
+        double bg_power = Power(bg);
+        if (bg_power > 0) {
+            // Loop the background if it is shorter than the clip.
+            Eigen::Index start = background_offset * bg.size();
+            Eigen::ArrayXd mix(x.size());
+            for (Eigen::Index i = 0; i < x.size(); i++) {
+                mix(i) = bg((start + i) % bg.size());
+            }
+            double target =
+                signal_power / std::pow(10, background_snr_db / 10);
+            x += mix * std::sqrt(target / bg_power);
+        }
+    }
+
+    /***************************************************************
+        Noise
+    ***************************************************************/
+    if (use_noise && signal_power > 0) {
+        double sigma =
+            std::sqrt(signal_power / std::pow(10, noise_snr_db / 10));
+        for (Eigen::Index i = 0; i < x.size(); i++) {
+            x(i) += sigma * random.Gaussian();
+        }
+    }
+
+    /***************************************************************
+        Gain
+    ***************************************************************/
+    if (gain_db != 0) {
+        x *= std::pow(10, gain_db / 20);
+    }
+
+    return x;
+}
@@ -0,0 +1,321 @@
+#include "bundle.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "reduce.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kMagic[8] = {'P', '7', '4', '8', 'B', 'N', 'D', 'L'};
+
+uint64_t Align(uint64_t offset) {
+    return (offset + kBundleAlignment - 1) / kBundleAlignment *
+           kBundleAlignment;
+}
+}  // namespace
+
+void ModelBundle::Save(fs::path filename, const FeatureConfig& config,
+                       int sample_rate, const Eigen::MatrixXd& basis,
+                       const Eigen::VectorXd& mean, int dims,
+                       const SvmModel& model) {
+    const svm_model* m = model.model();
+    if (!m) throw std::invalid_argument("The SVM has not been trained.");
+    if (m->param.kernel_type != LINEAR && m->param.kernel_type != RBF) {
+        throw std::invalid_argument(
+            "Only linear and RBF kernels can be bundled.");
+    }
+    if (dims < 1 || dims > basis.cols() || basis.rows() != mean.size()) {
+        throw std::invalid_argument("Basis, mean and dimensions do not match.");
+    }
+
+    const int num_classes = m->nr_class;
+    const int num_svs = m->l;
+
+    // Dense support vectors. libsvm omits zero components.
+    Eigen::MatrixXd svs = Eigen::MatrixXd::Zero(dims, num_svs);
+    for (int k = 0; k < num_svs; k++) {
+        for (const svm_node* n = m->SV[k]; n->index != -1; n++) {
+            if (n->index < 1 || n->index > dims) {
+                throw std::invalid_argument(
+                    "The SVM was trained on more than " +
+                    std::to_string(dims) + " dimensions.");
+            }
+            svs(n->index - 1, k) = n->value;
+        }
+    }
+
+    Eigen::MatrixXd coefs(num_svs, num_classes - 1);
+    for (int c = 0; c < num_classes - 1; c++) {
+        coefs.col(c) =
+            Eigen::Map<const Eigen::VectorXd>(m->sv_coef[c], num_svs);
+    }
+
+    BandedFilterbank filterbank =
+        BandedFilterbank::FromDense(CreateMelFilterbanks(
+            config.num_filters, sample_rate, WindowSize(sample_rate),
+            config.lowfreq, config.highfreq));
+    Eigen::MatrixXd truncated = basis.rightCols(dims).rowwise().reverse();
+
+    Header h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kBundleVersion;
+    h.header_size = sizeof(Header);
+    h.sample_rate = sample_rate;
+    h.num_filters = config.num_filters;
+    h.num_bins = filterbank.num_bins;
+    h.num_periods = config.num_periods;
+    h.num_weights = filterbank.weights.size();
+    h.lowfreq = config.lowfreq;
+    h.highfreq = config.highfreq;
+    h.step_sec = kStepSec;
+    h.window_sec = kWindowSec;
+    h.epsilon = kEpsilon;
+    h.feature_dims = mean.size();
+    h.dims = dims;
+    h.kernel = m->param.kernel_type;
+    h.num_classes = num_classes;
+    h.num_svs = num_svs;
+    h.gamma = m->param.gamma;
+
+    // Lay out each array after the previous one.
+    struct Array {
+        uint64_t* offset;
+        const void* data;
+        size_t bytes;
+    };
+    const std::vector<Array> arrays = {
+        {&h.first_bin_offset, filterbank.first_bin.data(),
+         filterbank.first_bin.size_bytes()},
+        {&h.band_offset, filterbank.offset.data(),
+         filterbank.offset.size_bytes()},
+        {&h.weights_offset, filterbank.weights.data(),
+         filterbank.weights.size_bytes()},
+        {&h.mean_offset, mean.data(), mean.size() * sizeof(double)},
+        {&h.basis_offset, truncated.data(), truncated.size() * sizeof(double)},
+        {&h.labels_offset, m->label, num_classes * sizeof(int32_t)},
+        {&h.class_sizes_offset, m->nSV, num_classes * sizeof(int32_t)},
+        {&h.svs_offset, svs.data(), svs.size() * sizeof(double)},
+        {&h.coefs_offset, coefs.data(), coefs.size() * sizeof(double)},
+        {&h.rho_offset, m->rho,
+         num_classes * (num_classes - 1) / 2 * sizeof(double)},
+    };
+    static_assert(sizeof(int) == sizeof(int32_t));
+
+    uint64_t end = sizeof(Header);
+    for (const auto& a : arrays) {
+        *a.offset = Align(end);
+        end = *a.offset + a.bytes;
+    }
+    h.file_size = end;
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open " + filename.string() +
+                                 " for writing.");
+    }
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    uint64_t written = sizeof(h);
+    const char zeros[kBundleAlignment] = {};
+    for (const auto& a : arrays) {
+        out.write(zeros, *a.offset - written);
+        out.write(static_cast<const char*>(a.data), a.bytes);
+        written = *a.offset + a.bytes;
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write " + filename.string());
+    }
+}
+
+ModelBundle::ModelBundle(fs::path filename) : file_(filename.string()) {
+    auto fail = [&](const std::string& reason) {
+        throw std::runtime_error(filename.string() + " is not a usable model " +
+                                 "bundle: " + reason);
+    };
+
+    if (std::endian::native != std::endian::little) {
+        fail("bundles are little-endian.");
+    }
+    if (!file_.data() || file_.size() < sizeof(Header)) {
+        fail("too short.");
+    }
+    const Header& h = header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0) {
+        fail("wrong magic number.");
+    }
+    if (h.version != kBundleVersion) {
+        fail("version " + std::to_string(h.version) + ", expected " +
+             std::to_string(kBundleVersion) + ".");
+    }
+    if (h.header_size != sizeof(Header) || h.file_size != file_.size()) {
+        fail("truncated or corrupt.");
+    }
+    if (h.num_filters < 1 || h.num_bins < 1 || h.num_periods < 1 ||
+        h.num_weights < 0 ||
+        h.feature_dims != int64_t(h.num_filters) * h.num_periods ||
+        h.dims < 1 || h.dims > h.feature_dims || h.num_classes < 1 ||
+        h.num_svs < 0) {
+        fail("inconsistent sizes.");
+    }
+    // Extraction uses the compiled-in constants, so a bundle made with other
+    // ones would be fed mismatched features.
+    if (h.step_sec != kStepSec || h.window_sec != kWindowSec ||
+        h.epsilon != kEpsilon) {
+        fail("built for a different hop, window or epsilon.");
+    }
+    if (h.kernel != LINEAR && h.kernel != RBF) {
+        fail("unsupported kernel " + std::to_string(h.kernel) + ".");
+    }
+    if (h.kernel == RBF && !(h.gamma > 0 && std::isfinite(h.gamma))) {
+        fail("RBF gamma must be positive.");
+    }
+
+    struct Array {
+        uint64_t offset;
+        int64_t rows;
+        int64_t cols;
+        size_t element;
+    };
+    const int64_t pairs = int64_t(h.num_classes) * (h.num_classes - 1) / 2;
+    const std::vector<Array> arrays = {
+        {h.first_bin_offset, h.num_filters, 1, sizeof(int32_t)},
+        {h.band_offset, h.num_filters + 1, 1, sizeof(int32_t)},
+        {h.weights_offset, h.num_weights, 1, sizeof(double)},
+        {h.mean_offset, h.feature_dims, 1, sizeof(double)},
+        {h.basis_offset, h.feature_dims, h.dims, sizeof(double)},
+        {h.labels_offset, h.num_classes, 1, sizeof(int32_t)},
+        {h.class_sizes_offset, h.num_classes, 1, sizeof(int32_t)},
+        {h.svs_offset, h.dims, h.num_svs, sizeof(double)},
+        {h.coefs_offset, h.num_svs, h.num_classes - 1, sizeof(double)},
+        {h.rho_offset, pairs, 1, sizeof(double)},
+    };
+    for (const auto& a : arrays) {
+        if (a.offset % kBundleAlignment != 0 || a.offset < sizeof(Header) ||
+            a.offset > file_.size()) {
+            fail("an array is out of bounds.");
+        }
+        // Divides rather than multiplies so huge sizes cannot overflow.
+        uint64_t space = (file_.size() - a.offset) / a.element;
+        if (a.cols != 0 && uint64_t(a.rows) > space / a.cols) {
+            fail("an array is out of bounds.");
+        }
+    }
+
+    const int32_t* class_sizes = Section<int32_t>(h.class_sizes_offset);
+    if (std::any_of(class_sizes, class_sizes + h.num_classes,
+                    [](int32_t n) { return n < 0; }) ||
+        std::accumulate(class_sizes, class_sizes + h.num_classes, 0ll) !=
+            h.num_svs) {
+        fail("support vector counts do not add up.");
+    }
+
+    // Every band must lie within the spectrum and the weights.
+    const int32_t* first_bin = Section<int32_t>(h.first_bin_offset);
+    const int32_t* band = Section<int32_t>(h.band_offset);
+    if (band[0] != 0 || band[h.num_filters] != h.num_weights) {
+        fail("filter bands do not cover the weights.");
+    }
+    for (int f = 0; f < h.num_filters; f++) {
+        if (band[f + 1] < band[f] || first_bin[f] < 0 ||
+            int64_t(first_bin[f]) + band[f + 1] - band[f] > h.num_bins) {
+            fail("a filter band is out of bounds.");
+        }
+    }
+
+    config_.num_filters = h.num_filters;
+    config_.lowfreq = h.lowfreq;
+    config_.highfreq = h.highfreq;
+    config_.num_periods = h.num_periods;
+
+    // Extraction reads the bands straight from the mapping.
+    filterbanks_.num_bins = h.num_bins;
+    filterbanks_.first_bin = {first_bin, size_t(h.num_filters)};
+    filterbanks_.offset = {band, size_t(h.num_filters) + 1};
+    filterbanks_.weights = {Section<double>(h.weights_offset),
+                            size_t(h.num_weights)};
+}
+
+const ModelBundle::Header& ModelBundle::header() const {
+    return *reinterpret_cast<const Header*>(file_.data());
+}
+
+template <typename T>
+const T* ModelBundle::Section(uint64_t offset) const {
+    return reinterpret_cast<const T*>(file_.data() + offset);
+}
+
+int ModelBundle::sample_rate() const {
+    return header().sample_rate;
+}
+
+int ModelBundle::dims() const {
+    return header().dims;
+}
+
+Eigen::Map<const Eigen::VectorXd> ModelBundle::mean() const {
+    const Header& h = header();
+    return {Section<double>(h.mean_offset), h.feature_dims};
+}
+
+Eigen::Map<const Eigen::MatrixXd> ModelBundle::basis() const {
+    const Header& h = header();
+    return {Section<double>(h.basis_offset), h.feature_dims, h.dims};
+}
+
+Eigen::VectorXd ModelBundle::Reduce(const Eigen::ArrayXXd& feature) const {
+    Eigen::VectorXd centered = FlattenFeature(feature).matrix() - mean();
+    return basis().transpose() * centered;
+}
+
+int ModelBundle::Predict(const Eigen::VectorXd& reduced) const {
+    const Header& h = header();
+    assert(reduced.size() == h.dims);
+
+    Eigen::Map<const Eigen::MatrixXd> svs(Section<double>(h.svs_offset),
+                                          h.dims, h.num_svs);
+    Eigen::Map<const Eigen::MatrixXd> coefs(Section<double>(h.coefs_offset),
+                                            h.num_svs, h.num_classes - 1);
+    Eigen::Map<const Eigen::VectorXd> rho(
+        Section<double>(h.rho_offset), h.num_classes * (h.num_classes - 1) / 2);
+    const int32_t* labels = Section<int32_t>(h.labels_offset);
+    const int32_t* class_sizes = Section<int32_t>(h.class_sizes_offset);
+
+    // Kernel between the sample and every support vector, computed the same
+    // way as libsvm's k_function.
+    Eigen::VectorXd kernel;
+    if (h.kernel == RBF) {
+        kernel = (-h.gamma * (svs.colwise() - reduced).colwise().squaredNorm())
+                     .transpose()
+                     .array()
+                     .exp();
+    } else {
+        kernel = svs.transpose() * reduced;
+    }
+
+    Eigen::VectorXd decision = CombinePairs(coefs, class_sizes, kernel) - rho;
+
+    double margin;
+    return labels[VoteWithMargin(decision, h.num_classes, &margin)];
+}
+
+int ModelBundle::Classify(const Eigen::Ref<const Eigen::ArrayXd>& audio,
+                          int sample_rate,
+                          ExtractorWorkspace& workspace) const {
+    if (sample_rate != header().sample_rate) {
+        throw std::invalid_argument(
+            "Audio is " + std::to_string(sample_rate) + " Hz but the model " +
+            "expects " + std::to_string(header().sample_rate) + " Hz.");
+    }
+    const Eigen::ArrayXXd& pooled = workspace.Extract(
+        audio, sample_rate, filterbanks_, config_.num_periods);
+    return Predict(Reduce(pooled));
+}
@@ -0,0 +1,209 @@
+#include "cascade.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#include "fileio.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+std::vector<Cascade::Stage> TrainStages(const Eigen::MatrixXd& reduced,
+                                        const std::vector<int>& labels,
+                                        const std::vector<int>& rows,
+                                        const std::vector<int>& dims) {
+    std::vector<int> y;
+    for (int r : rows) y.push_back(labels[r]);
+
+    std::vector<Cascade::Stage> stages;
+    for (int k = 0; k < dims.size(); k++) {
+        bool last = k + 1 == dims.size();
+        Eigen::MatrixXd x = reduced(rows, Eigen::seqN(0, dims[k]));
+
+        Cascade::Stage s;
+        s.dims = dims[k];
+        s.threshold = std::numeric_limits<double>::infinity();
+        s.model =
+            SvmModel::Train(x, y, last ? SvmKernel::kRbf : SvmKernel::kLinear);
+        if (!last) s.linear = LinearSvm(s.model, s.dims);
+        stages.push_back(std::move(s));
+    }
+    return stages;
+}
+
+struct Calibration {
+    double margin;
+    bool correct;        // by this stage
+    bool final_correct;  // by the last stage
+};
+
+// Smallest threshold such that this stage gets right every sample with at
+// least that margin that the last stage gets right. Infinite if there is
+// none.
+double CalibrateThreshold(std::vector<Calibration> samples) {
+    std::sort(samples.begin(), samples.end(),
+              [](const auto& a, const auto& b) { return a.margin > b.margin; });
+
+    double threshold = std::numeric_limits<double>::infinity();
+    for (int n = 0; n < samples.size(); n++) {
+        if (samples[n].final_correct && !samples[n].correct) break;
+
+        // Equal margins exit together, so only test after the last of them.
+        bool tied = n + 1 < samples.size() &&
+                    samples[n + 1].margin == samples[n].margin;
+        if (!tied) threshold = samples[n].margin;
+    }
+    return threshold;
+}
+
+fs::path StageModelFile(const fs::path& stem, int k) {
+    return fs::path(stem).replace_extension(".stage" + std::to_string(k) +
+                                            ".model");
+}
+}  // namespace
+
+Cascade Cascade::Train(const Eigen::MatrixXd& reduced,
+                       const std::vector<int>& labels,
+                       const std::vector<int>& dims) {
+    if (dims.empty() || !std::is_sorted(dims.begin(), dims.end()) ||
+        std::adjacent_find(dims.begin(), dims.end()) != dims.end() ||
+        dims.front() < 1 || dims.back() > reduced.cols()) {
+        throw std::invalid_argument(
+            "Stage dimensions must be increasing and at most " +
+            std::to_string(reduced.cols()) + ".");
+    }
+
+    /***************************************************************
+        Calibrate thresholds on held out samples
+    ***************************************************************/
+    // Every sample is held out once, by models trained on the other folds,
+    // so every sample counts towards the thresholds.
+    const int kFolds = 5;
+    const int num_stages = dims.size();
+    Eigen::ArrayXXd margins(reduced.rows(), num_stages - 1);
+    Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> correct(reduced.rows(),
+                                                               num_stages);
+    for (int fold = 0; fold < kFolds; fold++) {
+        std::vector<int> fit_rows;
+        std::vector<int> calibration_rows;
+        for (int r = 0; r < reduced.rows(); r++) {
+            (r % kFolds == fold ? calibration_rows : fit_rows).push_back(r);
+        }
+
+        std::vector<Stage> held_out =
+            TrainStages(reduced, labels, fit_rows, dims);
+        for (int r : calibration_rows) {
+            for (int k = 0; k < num_stages; k++) {
+                Eigen::VectorXd x = reduced.row(r).head(dims[k]);
+                int label = k + 1 < num_stages
+                                ? held_out[k].linear.Predict(x, &margins(r, k))
+                                : held_out[k].model.Predict(x);
+                correct(r, k) = label == labels[r];
+            }
+        }
+    }
+
+    // Easy samples exit early, and the last stage is nearly always right on
+    // those, so each stage is compared with it on the samples it would let
+    // exit rather than on the whole set. Each stage is calibrated on the
+    // samples that reach it.
+    std::vector<double> thresholds;
+    std::vector<int> remaining(reduced.rows());
+    std::iota(remaining.begin(), remaining.end(), 0);
+    for (int k = 0; k + 1 < num_stages; k++) {
+        std::vector<Calibration> samples;
+        for (int r : remaining) {
+            samples.push_back(
+                {margins(r, k), correct(r, k), correct(r, num_stages - 1)});
+        }
+        thresholds.push_back(CalibrateThreshold(samples));
+
+        std::vector<int> reaching;
+        for (int r : remaining) {
+            if (margins(r, k) < thresholds.back()) reaching.push_back(r);
+        }
+        remaining = std::move(reaching);
+    }
+
+    /***************************************************************
+        Retrain on every sample
+    ***************************************************************/
+    std::vector<int> all_rows(reduced.rows());
+    std::iota(all_rows.begin(), all_rows.end(), 0);
+
+    Cascade cascade;
+    cascade.stages_ = TrainStages(reduced, labels, all_rows, dims);
+    for (int k = 0; k < thresholds.size(); k++) {
+        cascade.stages_[k].threshold = thresholds[k];
+    }
+    return cascade;
+}
+
+void Cascade::Save(fs::path stem) const {
+    Eigen::ArrayXXd table(stages_.size(), 2);
+    for (int k = 0; k < stages_.size(); k++) {
+        table(k, 0) = stages_[k].dims;
+        table(k, 1) = stages_[k].threshold;
+        stages_[k].model.Save(StageModelFile(stem, k));
+    }
+    SaveCSV(fs::path(stem).replace_extension(".cascade"), table,
+            {"dims", "threshold"});
+}
+
+Cascade Cascade::Load(fs::path stem) {
+    Eigen::ArrayXXd table =
+        LoadCSV(fs::path(stem).replace_extension(".cascade"), 1);
+
+    Cascade cascade;
+    for (int k = 0; k < table.rows(); k++) {
+        Stage s;
+        s.dims = table(k, 0);
+        s.threshold = table(k, 1);
+        s.model = SvmModel::Load(StageModelFile(stem, k));
+        if (k + 1 < table.rows()) s.linear = LinearSvm(s.model, s.dims);
+        cascade.stages_.push_back(std::move(s));
+    }
+    return cascade;
+}
+
+Cascade::Prediction Cascade::Predict(const Eigen::VectorXd& centered,
+                                     const QuantizedMatrix& basis,
+                                     std::vector<double>* stage_seconds) const {
+    using Clock = std::chrono::steady_clock;
+    if (stage_seconds) stage_seconds->resize(stages_.size());
+
+    Eigen::VectorXd reduced(stages_.back().dims);
+    int projected = 0;
+
+    for (int k = 0; k < stages_.size(); k++) {
+        auto start = Clock::now();
+        const Stage& s = stages_[k];
+
+        // The basis has the largest eigenvalues on the right. Only project
+        // onto the components this stage adds, most important first.
+        if (s.dims > projected) {
+            Eigen::VectorXd added = basis.TransposeProduct(
+                centered, basis.cols() - s.dims, s.dims - projected);
+            reduced.segment(projected, s.dims - projected) = added.reverse();
+            projected = s.dims;
+        }
+
+        bool last = k + 1 == stages_.size();
+        Eigen::VectorXd x = reduced.head(s.dims);
+        double margin = 0;
+        int label =
+            last ? s.model.Predict(x) : s.linear.Predict(x, &margin);
+
+        if (stage_seconds) {
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+            (*stage_seconds)[k] += elapsed.count();
+        }
+        if (last || margin >= s.threshold) return {label, k};
+    }
+    return {};  // unreachable, the last stage always returns
+}
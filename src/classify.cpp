@@ -0,0 +1,288 @@
+#include "classify.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "fileio.hpp"
+#include "quantize.hpp"
+
+namespace fs = std::filesystem;
+
+LabelledSamples LoadLabelledSamples(fs::path listing) {
+    std::vector<fs::path> files = ReadFileListing(listing);
+    for (const auto& f : files) {
+        if (f.extension() != ".reduced") {
+            throw std::invalid_argument("Expected a .reduced file. Got " +
+                                        f.string());
+        }
+    }
+
+    LabelledSamples s;
+    s.labels.reserve(files.size());
+    int row = 0;
+
+    RunPipeline<Eigen::MatrixXd, Eigen::MatrixXd>(
+        files,
+        [](const fs::path& f) -> Eigen::MatrixXd { return LoadMatrix(f); },
+        [](Eigen::MatrixXd samples) { return samples; },
+        [&](const fs::path& f, Eigen::MatrixXd samples) {
+            if (row == 0) s.features.resize(files.size(), samples.rows());
+            if (samples.rows() != s.features.cols()) {
+                throw std::runtime_error(
+                    f.string() + " has " + std::to_string(samples.rows()) +
+                    " dimensions. Expected " +
+                    std::to_string(s.features.cols()) + ".");
+            }
+
+            // Files holding several samples need more rows than files.
+            if (row + samples.cols() > s.features.rows()) {
+                s.features.conservativeResize(
+                    std::max<Eigen::Index>(2 * s.features.rows(),
+                                           row + samples.cols()),
+                    Eigen::NoChange);
+            }
+            s.features.middleRows(row, samples.cols()) = samples.transpose();
+            row += samples.cols();
+            s.labels.insert(s.labels.end(), samples.cols(),
+                            f.stem().string()[0] - '0');
+        });
+    s.features.conservativeResize(row, Eigen::NoChange);
+    return s;
+}
+
+std::vector<svm_node> ToSvmNodes(const Eigen::MatrixXd& samples,
+                                 std::vector<svm_node*>& rows) {
+    const int dims = samples.cols();
+    std::vector<svm_node> nodes(samples.rows() * (dims + 1));
+
+    rows.resize(samples.rows());
+    for (int r = 0; r < samples.rows(); r++) {
+        svm_node* row = &nodes[r * (dims + 1)];
+        for (int i = 0; i < dims; i++) {
+            row[i].index = i + 1;
+            row[i].value = samples(r, i);
+        }
+        row[dims].index = -1;
+        rows[r] = row;
+    }
+    return nodes;
+}
+
+static std::vector<svm_node> ToSvmNodes(const Eigen::VectorXd& sample) {
+    std::vector<svm_node> nodes(sample.size() + 1);
+    for (int i = 0; i < sample.size(); i++) {
+        nodes[i].index = i + 1;
+        nodes[i].value = sample(i);
+    }
+    nodes[sample.size()].index = -1;
+    return nodes;
+}
+
+SvmModel::~SvmModel() {
+    svm_free_and_destroy_model(&model_);
+}
+
+SvmModel::SvmModel(SvmModel&& other) noexcept
+    : model_(other.model_), nodes_(std::move(other.nodes_)) {
+    other.model_ = nullptr;
+}
+
+SvmModel& SvmModel::operator=(SvmModel&& other) noexcept {
+    if (this != &other) {
+        svm_free_and_destroy_model(&model_);
+        model_ = other.model_;
+        nodes_ = std::move(other.nodes_);
+        other.model_ = nullptr;
+    }
+    return *this;
+}
+
+SvmModel SvmModel::Train(const Eigen::MatrixXd& samples,
+                         const std::vector<int>& labels, SvmKernel kernel) {
+    if (samples.rows() != labels.size()) {
+        throw std::invalid_argument(
+            "Got " + std::to_string(samples.rows()) + " samples but " +
+            std::to_string(labels.size()) + " labels.");
+    }
+    if (samples.rows() == 0) {
+        throw std::invalid_argument("Cannot train on zero samples.");
+    }
+
+    SvmModel m;
+    std::vector<svm_node*> rows;
+    m.nodes_ = ToSvmNodes(samples, rows);
+    std::vector<double> y(labels.begin(), labels.end());
+
+    svm_problem problem{};
+    problem.l = samples.rows();
+    problem.y = y.data();
+    problem.x = rows.data();
+
+    svm_parameter param{};
+    param.svm_type = C_SVC;
+    param.kernel_type = kernel == SvmKernel::kRbf ? RBF : LINEAR;
+    param.gamma = 1. / samples.cols();
+    param.C = 1;
+    param.cache_size = 100;
+    param.eps = 1e-3;
+    param.shrinking = 1;
+
+    const char* error = svm_check_parameter(&problem, &param);
+    if (error) {
+        throw std::invalid_argument(std::string("libsvm: ") + error);
+    }
+
+    // libsvm prints its optimizer progress to stdout by default.
+    svm_set_print_string_function([](const char*) {});
+    m.model_ = svm_train(&problem, &param);
+
+    // The model keeps pointers to the support vectors but not to the arrays
+    // describing the problem, so those can go out of scope.
+    return m;
+}
+
+void SvmModel::Save(fs::path filename) const {
+    if (svm_save_model(filename.c_str(), model_) != 0) {
+        throw std::runtime_error("Failed to save model to " +
+                                 filename.string());
+    }
+}
+
+SvmModel SvmModel::Load(fs::path filename) {
+    SvmModel m;
+    m.model_ = svm_load_model(filename.c_str());
+    if (!m.model_) {
+        throw std::runtime_error("Could not load model " + filename.string());
+    }
+    return m;
+}
+
+int SvmModel::Predict(const Eigen::VectorXd& sample) const {
+    std::vector<svm_node> nodes = ToSvmNodes(sample);
+    return svm_predict(model_, nodes.data());
+}
+
+int SvmModel::Predict(const Eigen::VectorXd& sample, double* margin) const {
+    std::vector<svm_node> nodes = ToSvmNodes(sample);
+
+    int num_classes = svm_get_nr_class(model_);
+    Eigen::VectorXd decision(num_classes * (num_classes - 1) / 2);
+    svm_predict_values(model_, nodes.data(), decision.data());
+    return model_->label[VoteWithMargin(decision, num_classes, margin)];
+}
+
+std::vector<int> SvmModel::Predict(const Eigen::MatrixXd& samples,
+                                   int num_threads) const {
+    std::vector<svm_node*> rows;
+    std::vector<svm_node> nodes = ToSvmNodes(samples, rows);
+    std::vector<int> predictions(samples.rows());
+
+    // svm_predict only reads the model, so the rows can be split freely.
+    num_threads = std::max(1, num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        int first = static_cast<long>(samples.rows()) * t / num_threads;
+        int last = static_cast<long>(samples.rows()) * (t + 1) / num_threads;
+        if (first == last) continue;
+
+        threads.emplace_back([&, first, last] {
+            for (int r = first; r < last; r++) {
+                predictions[r] = svm_predict(model_, rows[r]);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return predictions;
+}
+
+LinearSvm::LinearSvm(const SvmModel& model, int dims) {
+    const svm_model* m = model.model();
+    assert(m->param.kernel_type == LINEAR);
+
+    const int num_classes = m->nr_class;
+    labels_.assign(m->label, m->label + num_classes);
+
+    // Same coefficients as svm_predict_values, with the kernel sum
+    // sum_k coef_k <sv_k, x> collapsed to <sum_k coef_k sv_k, x>.
+    Eigen::MatrixXd svs = Eigen::MatrixXd::Zero(m->l, dims);
+    for (int k = 0; k < m->l; k++) {
+        for (const svm_node* n = m->SV[k]; n->index != -1; n++) {
+            if (n->index > dims) {
+                throw std::invalid_argument(
+                    "Support vector has feature " + std::to_string(n->index) +
+                    " but samples have " + std::to_string(dims) +
+                    " dimensions.");
+            }
+            svs(k, n->index - 1) = n->value;
+        }
+    }
+    Eigen::MatrixXd coefs(m->l, num_classes - 1);
+    for (int c = 0; c < num_classes - 1; c++) {
+        coefs.col(c) = Eigen::Map<const Eigen::VectorXd>(m->sv_coef[c], m->l);
+    }
+
+    weights_ = CombinePairs(coefs, m->nSV, svs);
+    rho_ = Eigen::Map<const Eigen::VectorXd>(m->rho, weights_.rows());
+}
+
+int LinearSvm::Predict(const Eigen::VectorXd& sample, double* margin) const {
+    assert(sample.size() == weights_.cols());
+    Eigen::VectorXd decision = weights_ * sample - rho_;
+    return labels_[VoteWithMargin(decision, labels_.size(), margin)];
+}
+
+Eigen::MatrixXd CombinePairs(const Eigen::Ref<const Eigen::MatrixXd>& coefs,
+                             const int* class_sizes,
+                             const Eigen::Ref<const Eigen::MatrixXd>& rows) {
+    assert(coefs.rows() == rows.rows());
+    const int num_classes = coefs.cols() + 1;
+
+    // start[c] is the first support vector of class c.
+    std::vector<int> start(num_classes, 0);
+    for (int c = 1; c < num_classes; c++) {
+        start[c] = start[c - 1] + class_sizes[c - 1];
+    }
+
+    Eigen::MatrixXd pairs(num_classes * (num_classes - 1) / 2, rows.cols());
+    int p = 0;
+    for (int i = 0; i < num_classes; i++) {
+        for (int j = i + 1; j < num_classes; j++) {
+            int si = start[i], ni = class_sizes[i];
+            int sj = start[j], nj = class_sizes[j];
+            pairs.row(p++) = coefs.col(j - 1).segment(si, ni).transpose() *
+                                 rows.middleRows(si, ni) +
+                             coefs.col(i).segment(sj, nj).transpose() *
+                                 rows.middleRows(sj, nj);
+        }
+    }
+    return pairs;
+}
+
+int VoteWithMargin(const Eigen::VectorXd& decision_values, int num_classes,
+                   double* margin) {
+    std::vector<int> votes(num_classes, 0);
+    int p = 0;
+    for (int i = 0; i < num_classes; i++) {
+        for (int j = i + 1; j < num_classes; j++) {
+            votes[decision_values(p++) > 0 ? i : j]++;
+        }
+    }
+    int winner = std::max_element(votes.begin(), votes.end()) - votes.begin();
+
+    *margin = std::numeric_limits<double>::infinity();
+    p = 0;
+    for (int i = 0; i < num_classes; i++) {
+        for (int j = i + 1; j < num_classes; j++) {
+            if (i == winner) *margin = std::min(*margin, decision_values(p));
+            if (j == winner) *margin = std::min(*margin, -decision_values(p));
+            p++;
+        }
+    }
+    return winner;
+}
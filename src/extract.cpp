@@ -0,0 +1,363 @@
+#include "extract.hpp"
+
+#include <fftw3.h>
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "fileio.hpp"
+
+// FFTW planning is not thread-safe, only fftw_execute is.
+static std::mutex fftw_planner_mutex;
+
+// Using HTLK MFCC-FB24 [Ganchev]
+constexpr double hz2mel(double hz) {
+    return 2595 * std::log10(1 + hz / 700.);
+}
+
+constexpr double mel2hz(double mel) {
+    return 700 * (std::pow(10, mel / 2595.) - 1);
+}
+
+// Each row is a filter bank. Each column is an fft bin.
+Eigen::ArrayXXd CreateMelFilterbanks(int num_filters, double sample_rate,
+                                     int nfft, double lowfreq,
+                                     double highfreq) {
+    double mel_low = hz2mel(lowfreq);
+    double mel_center_delta = (hz2mel(highfreq) - mel_low) / (num_filters + 1);
+
+    int nbins = nfft / 2 + 1;
+
+    Eigen::ArrayXd fft_freqs =
+        Eigen::ArrayXd::LinSpaced(nbins, 0, sample_rate / 2);
+
+    Eigen::ArrayXXd filters = Eigen::ArrayXXd::Zero(num_filters, nbins);
+
+    for (int j = 1; j <= num_filters; j++) {
+        // Compute vertices of filter
+        double f_low = mel2hz(mel_low + mel_center_delta * (j - 1));
+        double f_center = mel2hz(mel_low + mel_center_delta * (j));
+        double f_high = mel2hz(mel_low + mel_center_delta * (j + 1));
+
+        // Create the triangle filter
+        for (int i = 0; i < nbins; i++) {
+            double f = fft_freqs[i];
+
+            if (f_low <= f && f <= f_center) {
+                filters(j - 1, i) = (f - f_low) / (f_center - f_low);
+            } else if (f_center <= f && f <= f_high) {
+                filters(j - 1, i) = (f_high - f) / (f_high - f_center);
+            } else {
+                continue;  // these cells are already 0
+            }
+        }
+    }
+    return filters;
+}
+
+std::string FeatureConfig::Tag() const {
+    // A '.' would be read as an extension, so 62.5 Hz is written 62p5.
+    auto hz = [](double f) {
+        std::ostringstream ss;
+        ss << f;
+        std::string s = ss.str();
+        std::replace(s.begin(), s.end(), '.', 'p');
+        return s;
+    };
+    return "m" + std::to_string(num_filters) + "-" + hz(lowfreq) + "-" +
+           hz(highfreq) + "-p" + std::to_string(num_periods);
+}
+
+std::vector<FeatureConfig> LoadFeatureConfigs(std::filesystem::path filename) {
+    Eigen::ArrayXXd values = LoadCSV(filename, 1);
+    if (values.cols() != 4) {
+        throw std::invalid_argument(
+            filename.string() +
+            " must have the columns num_filters,lowfreq,highfreq,num_periods.");
+    }
+
+    std::vector<FeatureConfig> configs;
+    for (int i = 0; i < values.rows(); i++) {
+        FeatureConfig c;
+        c.num_filters = values(i, 0);
+        c.lowfreq = values(i, 1);
+        c.highfreq = values(i, 2);
+        c.num_periods = values(i, 3);
+
+        if (c.num_filters < 1 || c.num_periods < 1 || c.lowfreq < 0 ||
+            c.lowfreq >= c.highfreq) {
+            throw std::invalid_argument("Invalid configuration " + c.Tag() +
+                                        " on line " + std::to_string(i + 2) +
+                                        " of " + filename.string() + ".");
+        }
+        for (const auto& other : configs) {
+            if (other.Tag() == c.Tag()) {
+                throw std::invalid_argument("Configuration " + c.Tag() +
+                                            " is repeated in " +
+                                            filename.string() + ".");
+            }
+        }
+        configs.push_back(c);
+    }
+    return configs;
+}
+
+int HopSize(int sample_rate) {
+    return kStepSec * sample_rate;
+}
+
+int WindowSize(int sample_rate) {
+    return kWindowSec * sample_rate;
+}
+
+ExtractorWorkspace::~ExtractorWorkspace() {
+    std::lock_guard lock(fftw_planner_mutex);
+    if (plan_) fftw_destroy_plan(plan_);
+    fftw_free(frame_);
+    fftw_free(spectrum_);
+}
+
+void ExtractorWorkspace::Prepare(int sample_rate) {
+    if (sample_rate == sample_rate_) return;
+
+    sample_rate_ = sample_rate;
+    hop_ = HopSize(sample_rate);
+    fftn_ = WindowSize(sample_rate);
+    int num_bins = fftn_ / 2 + 1;
+
+    window_ = BlackmanWindow(fftn_);
+    window_ /= window_.sum();  // normalized window to unit mass
+
+    mel_filterbanks_ = BandedFilterbank::FromDense(CreateMelFilterbanks(
+        kNumFilters, sample_rate, fftn_, kLowFreq, kHighFreq));
+
+    // Plan once on our own aligned buffers. Each frame is copied in and the
+    // plan is reused.
+    std::lock_guard lock(fftw_planner_mutex);
+    if (plan_) fftw_destroy_plan(plan_);
+    fftw_free(frame_);
+    fftw_free(spectrum_);
+    frame_ = fftw_alloc_real(fftn_);
+    spectrum_ = fftw_alloc_complex(num_bins);
+    plan_ = fftw_plan_dft_r2c_1d(fftn_, frame_, spectrum_, FFTW_ESTIMATE);
+
+    // Frame capacity depends on the hop so start again.
+    power_spectrum_.resize(num_bins, 0);
+    filtered_power_.resize(kNumFilters, 0);
+    num_frames_ = 0;
+
+    // Filterbanks depend on the FFT size.
+    configs_.clear();
+}
+
+void ExtractorWorkspace::PrepareConfigs(
+    const std::vector<FeatureConfig>& configs) {
+    if (configs == configs_) return;
+
+    configs_ = configs;
+    config_filterbanks_.clear();
+    config_pooled_.clear();
+    for (const auto& c : configs_) {
+        config_filterbanks_.push_back(
+            BandedFilterbank::FromDense(CreateMelFilterbanks(
+                c.num_filters, sample_rate_, fftn_, c.lowfreq, c.highfreq)));
+        config_pooled_.emplace_back(c.num_filters, c.num_periods);
+    }
+}
+
+void ExtractorWorkspace::Reserve(int num_frames) {
+    if (num_frames <= power_spectrum_.cols()) return;
+    power_spectrum_.resize(power_spectrum_.rows(), num_frames);
+    filtered_power_.resize(filtered_power_.rows(), num_frames);
+}
+
+void ExtractorWorkspace::PowerFrames(
+    const Eigen::Ref<const Eigen::ArrayXd>& signal, int sample_rate,
+    double max_amplitude) {
+    Prepare(sample_rate);
+
+    // The last frame is zero padded to align with window and hop
+    num_frames_ = (signal.size() - fftn_ + hop_ - 1) / hop_ + 1;
+    Reserve(num_frames_);
+
+    int num_bins = fftn_ / 2 + 1;
+    Eigen::Map<Eigen::ArrayXd> frame(frame_, fftn_);
+
+    for (int i = 0; i < num_frames_; i++) {
+        int start = i * hop_;
+        int available = std::min<int>(fftn_, signal.size() - start);
+
+        simd::WindowFrame(window_.data(), signal.data() + start,
+                          max_amplitude, frame_, available);
+        frame.tail(fftn_ - available).setZero();
+
+        fftw_execute(plan_);
+        simd::Abs2(spectrum_[0], power_spectrum_.col(i).data(), num_bins);
+    }
+}
+
+Eigen::Ref<const Eigen::ArrayXXd> ExtractorWorkspace::MelFrames(
+    const Eigen::Ref<const Eigen::ArrayXd>& signal, int sample_rate,
+    double max_amplitude) {
+    PowerFrames(signal, sample_rate, max_amplitude);
+
+    // Computes kNumFilters datapoints per frame.
+    for (int i = 0; i < num_frames_; i++) {
+        simd::ApplyFilterbank(mel_filterbanks_, power_spectrum_.col(i).data(),
+                              filtered_power_.col(i).data());
+    }
+
+    return FilteredPower();
+}
+
+const Eigen::ArrayXXd& ExtractorWorkspace::Extract(
+    const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate) {
+    /***************************************************************
+        Normalize Amplitude
+    ***************************************************************/
+    // Applied to each sample as it is copied into a frame.
+    double max_amplitude = audio.abs().maxCoeff();
+    assert(max_amplitude > 0);
+
+    /***************************************************************
+        Power Spectrum and Mel Filterbank
+    ***************************************************************/
+    auto filtered_power = MelFrames(audio, sample_rate, max_amplitude);
+
+    /***************************************************************
+        Pool to reduce time resolution
+    ***************************************************************/
+    double breaks = static_cast<double>(filtered_power.cols()) / kNumPeriods;
+
+    pooled_.resize(kNumFilters, kNumPeriods);
+    for (int i = 0; i < kNumPeriods; i++) {
+        int low_i = std::round(i * breaks);
+        int high_i = std::round((i + 1) * breaks);
+
+        for (int j = 0; j < kNumFilters; j++) {
+            pooled_(j, i) =
+                filtered_power.row(j).segment(low_i, high_i - low_i).mean();
+        }
+    }
+    assert(std::round(kNumPeriods * breaks) == filtered_power.cols());
+
+    /***************************************************************
+        Take log10 of pooled_power power
+    ***************************************************************/
+    simd::Log10(pooled_.data(), pooled_.size(), kEpsilon, fast_log_);
+    assert(!pooled_.isNaN().any());
+
+    return pooled_;
+}
+
+const std::vector<Eigen::ArrayXXd>& ExtractorWorkspace::Extract(
+    const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate,
+    const std::vector<FeatureConfig>& configs) {
+    double max_amplitude = audio.abs().maxCoeff();
+    assert(max_amplitude > 0);
+
+    // The STFT is shared by every configuration.
+    PowerFrames(audio, sample_rate, max_amplitude);
+    PrepareConfigs(configs);
+
+    for (int c = 0; c < configs_.size(); c++) {
+        PoolLogMel(config_filterbanks_[c], configs_[c].num_periods,
+                   config_pooled_[c]);
+    }
+
+    return config_pooled_;
+}
+
+const Eigen::ArrayXXd& ExtractorWorkspace::Extract(
+    const Eigen::Ref<const Eigen::ArrayXd>& audio, int sample_rate,
+    const BandedFilterbank& filterbanks, int num_periods) {
+    double max_amplitude = audio.abs().maxCoeff();
+    assert(max_amplitude > 0);
+
+    PowerFrames(audio, sample_rate, max_amplitude);
+    if (filterbanks.num_bins != fftn_ / 2 + 1) {
+        throw std::invalid_argument(
+            "Filterbank has " + std::to_string(filterbanks.num_bins) +
+            " bins but " + std::to_string(sample_rate) + " Hz audio has " +
+            std::to_string(fftn_ / 2 + 1) + ".");
+    }
+
+    pooled_.resize(filterbanks.num_filters(), num_periods);
+    PoolLogMel(filterbanks, num_periods, pooled_);
+    return pooled_;
+}
+
+void ExtractorWorkspace::PoolLogMel(const BandedFilterbank& filterbanks,
+                                    int num_periods, Eigen::ArrayXXd& pooled) {
+    const int num_filters = filterbanks.num_filters();
+    auto power_spectrum = PowerSpectrum();
+
+    if (cumulative_.rows() < num_filters ||
+        cumulative_.cols() < num_frames_ + 1) {
+        cumulative_.resize(std::max<int>(cumulative_.rows(), num_filters),
+                           std::max<int>(cumulative_.cols(), num_frames_ + 1));
+    }
+
+    // Filter each frame into columns 1..num_frames then turn them into a
+    // running total in place. Column i is the sum of frames [0, i).
+    auto cumulative = cumulative_.topLeftCorner(num_filters, num_frames_ + 1);
+    cumulative.col(0).setZero();
+    for (int i = 1; i <= num_frames_; i++) {
+        simd::ApplyFilterbank(filterbanks, power_spectrum.col(i - 1).data(),
+                              cumulative.col(i).data());
+        cumulative.col(i) += cumulative.col(i - 1);
+    }
+
+    // Same period boundaries as the single configuration Extract.
+    double breaks = static_cast<double>(num_frames_) / num_periods;
+    for (int i = 0; i < num_periods; i++) {
+        int low_i = std::round(i * breaks);
+        int high_i = std::round((i + 1) * breaks);
+        pooled.col(i) = (cumulative.col(high_i) - cumulative.col(low_i)) /
+                        (high_i - low_i);
+    }
+    simd::Log10(pooled.data(), pooled.size(), kEpsilon, fast_log_);
+    assert(!pooled.isNaN().any());
+}
+
+Eigen::Ref<const Eigen::ArrayXXd> ExtractorWorkspace::PowerSpectrum() const {
+    return power_spectrum_.leftCols(num_frames_);
+}
+
+Eigen::Ref<const Eigen::ArrayXXd> ExtractorWorkspace::FilteredPower() const {
+    return filtered_power_.leftCols(num_frames_);
+}
+
+Eigen::ArrayXXd ExtractFeature(const AudioFile& aud, bool images) {
+    ExtractorWorkspace workspace;
+    Eigen::ArrayXXd pooled = workspace.Extract(aud.data, aud.sample_rate);
+
+    if (images) {
+        Eigen::ArrayXXd power_spectrum = workspace.PowerSpectrum();
+        SaveImage("power_spectrum.png", power_spectrum, 0,
+                  power_spectrum.maxCoeff());
+
+        Eigen::ArrayXXd fp_img = (workspace.FilteredPower() + 1e-8).log10();
+        SaveImage("mel_binned.png", fp_img, fp_img.minCoeff(),
+                  fp_img.maxCoeff());
+
+        SaveImage("pooled_mel.png", pooled, pooled.minCoeff(),
+                  pooled.maxCoeff());
+    }
+
+    return pooled;
+}
+
+Eigen::ArrayXd BlackmanWindow(int N) {
+    constexpr double PI = 3.14159265358979323;
+    // https://numpy.org/doc/stable/reference/routines.window.html
+    return Eigen::ArrayXd::LinSpaced(N, 0, N - 1).unaryExpr([&](double n) {
+        return 0.42 - 0.5 * std::cos(2. * PI * n / (N - 1)) +
+               0.08 * std::cos(4. * PI * n / (N - 1));
+    });
+}
\ No newline at end of file
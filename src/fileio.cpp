@@ -1,5 +1,10 @@
 #include "fileio.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <cassert>
 #include <cmath>
 #include <filesystem>
@@ -191,4 +196,24 @@ void SaveImage(std::filesystem::path filename, Eigen::ArrayXXd values,
 
     stbi_write_png(filename.string().c_str(), cols, rows, 3, image_buffer,
                    cols * 3);
-}
\ No newline at end of file
+}
+
+MappedFile::MappedFile(const std::string& filename, bool sequential) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data_ = static_cast<const uint8_t*>(p);
+            size_ = st.st_size;
+            if (sequential) madvise(p, size_, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);  // the mapping stays valid
+}
+
+MappedFile::~MappedFile() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+}
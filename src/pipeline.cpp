@@ -0,0 +1,33 @@
+#include "pipeline.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+int DefaultThreadCount() {
+    if (const char* env = std::getenv("PROJ748_THREADS")) {
+        int n = std::atoi(env);
+        if (n > 0) return n;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+uint64_t Fnv1a(const std::string& s) {
+    uint64_t hash = 14695981039346656037ull;  // offset basis
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;  // FNV prime
+    }
+    return hash;
+}
+
+std::vector<std::filesystem::path> ShardFiles(
+    const std::vector<std::filesystem::path>& files, int shard,
+    int num_shards) {
+    std::vector<std::filesystem::path> selected;
+    for (const auto& f : files) {
+        if (Fnv1a(f.string()) % num_shards == shard) selected.push_back(f);
+    }
+    return selected;
+}
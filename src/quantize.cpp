@@ -0,0 +1,321 @@
+#include "quantize.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "fileio.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+const char kMagic[4] = {'P', '7', '4', '8'};
+const uint32_t kVersion = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t encoding;
+    int32_t rows;
+    int32_t cols;
+};
+}  // namespace
+
+Encoding ParseEncoding(const std::string& name) {
+    if (name == "text") return Encoding::kText;
+    if (name == "f64") return Encoding::kFloat64;
+    if (name == "fp16") return Encoding::kFloat16;
+    if (name == "int8") return Encoding::kInt8;
+    throw std::invalid_argument("Unknown encoding '" + name +
+                                "'. Expected text, f64, fp16 or int8.");
+}
+
+std::string EncodingName(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::kText:
+            return "text";
+        case Encoding::kFloat64:
+            return "f64";
+        case Encoding::kFloat16:
+            return "fp16";
+        case Encoding::kInt8:
+            return "int8";
+    }
+    return "unknown";
+}
+
+fs::path EncodedPath(const fs::path& file, const std::string& extension,
+                     Encoding encoding) {
+    if (encoding == Encoding::kText) {
+        return fs::path(file).replace_extension(extension);
+    }
+    return fs::path(file).replace_extension("." + EncodingName(encoding) +
+                                            extension);
+}
+
+QuantizedMatrix QuantizedMatrix::Encode(const Eigen::ArrayXXd& values,
+                                        Encoding encoding) {
+    QuantizedMatrix m;
+    m.encoding = encoding;
+
+    switch (encoding) {
+        case Encoding::kText:
+        case Encoding::kFloat64:
+            m.dense = values;
+            break;
+
+        case Encoding::kFloat16:
+            m.half = values.cast<float>().cast<Eigen::half>();
+            break;
+
+        case Encoding::kInt8:
+            // Map each column's [min, max] onto the 256 int8 levels.
+            m.q.resize(values.rows(), values.cols());
+            m.scale.resize(values.cols());
+            m.offset.resize(values.cols());
+            for (int c = 0; c < values.cols(); c++) {
+                double lo = values.col(c).minCoeff();
+                double hi = values.col(c).maxCoeff();
+                double scale = (hi - lo) / 255.;
+                if (scale == 0) {
+                    m.scale(c) = 0;
+                    m.offset(c) = lo;
+                    m.q.col(c).setZero();
+                    continue;
+                }
+                m.scale(c) = scale;
+                m.offset(c) = lo + 128. * scale;
+                m.q.col(c) = ((values.col(c) - m.offset(c)) / scale)
+                                 .round()
+                                 .max(-128.)
+                                 .min(127.)
+                                 .cast<int8_t>();
+            }
+            break;
+    }
+    return m;
+}
+
+Eigen::ArrayXXd QuantizedMatrix::Decode() const {
+    switch (encoding) {
+        case Encoding::kText:
+        case Encoding::kFloat64:
+            return dense;
+
+        case Encoding::kFloat16:
+            return half.cast<float>().cast<double>();
+
+        case Encoding::kInt8: {
+            Eigen::ArrayXXd values = q.cast<double>();
+            values.rowwise() *= scale.transpose();
+            values.rowwise() += offset.transpose();
+            return values;
+        }
+    }
+    return {};
+}
+
+int QuantizedMatrix::rows() const {
+    switch (encoding) {
+        case Encoding::kText:
+        case Encoding::kFloat64:
+            return dense.rows();
+        case Encoding::kFloat16:
+            return half.rows();
+        case Encoding::kInt8:
+            return q.rows();
+    }
+    return 0;
+}
+
+int QuantizedMatrix::cols() const {
+    switch (encoding) {
+        case Encoding::kText:
+        case Encoding::kFloat64:
+            return dense.cols();
+        case Encoding::kFloat16:
+            return half.cols();
+        case Encoding::kInt8:
+            return q.cols();
+    }
+    return 0;
+}
+
+Eigen::VectorXd QuantizedMatrix::TransposeProduct(const Eigen::VectorXd& x,
+                                                  int first_col,
+                                                  int num_cols) const {
+    assert(x.size() == rows());
+    assert(first_col + num_cols <= cols());
+
+    Eigen::VectorXd result(num_cols);
+    switch (encoding) {
+        case Encoding::kText:
+        case Encoding::kFloat64:
+            result =
+                dense.middleCols(first_col, num_cols).matrix().transpose() * x;
+            break;
+
+        case Encoding::kFloat16: {
+            Eigen::VectorXf xf = x.cast<float>();
+            for (int k = 0; k < num_cols; k++) {
+                result(k) =
+                    half.col(first_col + k).cast<float>().matrix().dot(xf);
+            }
+            break;
+        }
+
+        case Encoding::kInt8: {
+            // sum_i (offset + scale * q_i) x_i
+            //     = scale * (q . x) + offset * sum(x)
+            Eigen::VectorXf xf = x.cast<float>();
+            double x_sum = x.sum();
+            for (int k = 0; k < num_cols; k++) {
+                int c = first_col + k;
+                double dot = q.col(c).cast<float>().matrix().dot(xf);
+                result(k) = scale(c) * dot + offset(c) * x_sum;
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+void SaveMatrix(fs::path filename, const Eigen::ArrayXXd& array,
+                Encoding encoding) {
+    if (encoding == Encoding::kText) {
+        SaveCSV(filename, array);
+        return;
+    }
+    SaveMatrix(filename, QuantizedMatrix::Encode(array, encoding));
+}
+
+void SaveMatrix(fs::path filename, const QuantizedMatrix& matrix) {
+    if (matrix.encoding == Encoding::kText) {
+        SaveCSV(filename, matrix.dense);
+        return;
+    }
+
+    std::ofstream of(filename, std::ios::binary);
+    if (!of.is_open()) {
+        throw std::runtime_error("Failed to open " + filename.string() +
+                                 " for writing.");
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.encoding = static_cast<uint32_t>(matrix.encoding);
+    header.rows = matrix.rows();
+    header.cols = matrix.cols();
+    of.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Eigen arrays are column-major so each buffer is written as-is.
+    if (matrix.encoding == Encoding::kFloat64) {
+        of.write(reinterpret_cast<const char*>(matrix.dense.data()),
+                 matrix.dense.size() * sizeof(double));
+    } else if (matrix.encoding == Encoding::kFloat16) {
+        of.write(reinterpret_cast<const char*>(matrix.half.data()),
+                 matrix.half.size() * sizeof(Eigen::half));
+    } else {
+        of.write(reinterpret_cast<const char*>(matrix.scale.data()),
+                 matrix.scale.size() * sizeof(double));
+        of.write(reinterpret_cast<const char*>(matrix.offset.data()),
+                 matrix.offset.size() * sizeof(double));
+        of.write(reinterpret_cast<const char*>(matrix.q.data()),
+                 matrix.q.size() * sizeof(int8_t));
+    }
+}
+
+QuantizedMatrix LoadQuantized(fs::path filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filename.string());
+    }
+
+    Header header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        // Not a binary matrix so it must be text.
+        QuantizedMatrix m;
+        m.dense = LoadCSV(filename);
+        return m;
+    }
+
+    if (header.version != kVersion) {
+        throw std::runtime_error(filename.string() +
+                                 " has unsupported version " +
+                                 std::to_string(header.version) + ".");
+    }
+
+    QuantizedMatrix m;
+    m.encoding = static_cast<Encoding>(header.encoding);
+
+    // Bytes per value, plus the int8 scale and offset of each column.
+    uint64_t element;
+    uint64_t per_column = 0;
+    if (m.encoding == Encoding::kFloat64) {
+        element = sizeof(double);
+    } else if (m.encoding == Encoding::kFloat16) {
+        element = sizeof(Eigen::half);
+    } else if (m.encoding == Encoding::kInt8) {
+        element = sizeof(int8_t);
+        per_column = 2 * sizeof(double);
+    } else {
+        throw std::runtime_error(filename.string() + " has unknown encoding " +
+                                 std::to_string(header.encoding) + ".");
+    }
+
+    // The payload must be exactly what the header describes. Divides rather
+    // than multiplies so a corrupt header cannot overflow.
+    const uint64_t rows = header.rows;
+    const uint64_t cols = header.cols;
+    const uint64_t payload = fs::file_size(filename) - sizeof(header);
+    bool sized = header.rows >= 0 && header.cols >= 0;
+    if (sized && cols > 0) {
+        // Each column is its scale and offset, if any, then its values.
+        const uint64_t column_bytes = payload / cols;
+        sized = payload % cols == 0 && column_bytes >= per_column &&
+                (column_bytes - per_column) % element == 0 &&
+                (column_bytes - per_column) / element == rows;
+    } else if (sized) {
+        sized = payload == 0;
+    }
+    if (!sized) {
+        throw std::runtime_error(
+            filename.string() + " does not match its header: " +
+            std::to_string(header.rows) + " x " +
+            std::to_string(header.cols) + " " + EncodingName(m.encoding) +
+            " values in " + std::to_string(payload) + " bytes.");
+    }
+
+    if (m.encoding == Encoding::kFloat64) {
+        m.dense.resize(header.rows, header.cols);
+        file.read(reinterpret_cast<char*>(m.dense.data()),
+                  m.dense.size() * sizeof(double));
+    } else if (m.encoding == Encoding::kFloat16) {
+        m.half.resize(header.rows, header.cols);
+        file.read(reinterpret_cast<char*>(m.half.data()),
+                  m.half.size() * sizeof(Eigen::half));
+    } else {
+        m.scale.resize(header.cols);
+        m.offset.resize(header.cols);
+        m.q.resize(header.rows, header.cols);
+        file.read(reinterpret_cast<char*>(m.scale.data()),
+                  m.scale.size() * sizeof(double));
+        file.read(reinterpret_cast<char*>(m.offset.data()),
+                  m.offset.size() * sizeof(double));
+        file.read(reinterpret_cast<char*>(m.q.data()),
+                  m.q.size() * sizeof(int8_t));
+    }
+
+    if (!file) {
+        throw std::runtime_error(filename.string() + " is truncated.");
+    }
+    return m;
+}
+
+Eigen::ArrayXXd LoadMatrix(fs::path filename) {
+    return LoadQuantized(filename).Decode();
+}
@@ -0,0 +1,136 @@
+#include "scan.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "extract.hpp"
+
+Eigen::ArrayXXd ParallelMelFrames(const Eigen::ArrayXd& signal,
+                                  int sample_rate, int num_threads) {
+    int hop = HopSize(sample_rate);
+    int fftn = WindowSize(sample_rate);
+    int num_frames = (signal.size() - fftn + hop - 1) / hop + 1;
+
+    Eigen::ArrayXXd filtered_power(kNumFilters, num_frames);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        int first = static_cast<long>(num_frames) * t / num_threads;
+        int last = static_cast<long>(num_frames) * (t + 1) / num_threads;
+        if (first == last) continue;
+
+        threads.emplace_back([&, first, last] {
+            int start = first * hop;
+            int end = std::min<int>((last - 1) * hop + fftn, signal.size());
+
+            ExtractorWorkspace workspace;
+            auto segment = workspace.MelFrames(
+                signal.segment(start, end - start), sample_rate);
+            assert(segment.cols() == last - first);
+
+            filtered_power.middleCols(first, last - first) = segment;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return filtered_power;
+}
+
+RecordingScanner::RecordingScanner(const Eigen::ArrayXd& signal,
+                                   int sample_rate, int num_threads)
+    : signal_(signal),
+      hop_(HopSize(sample_rate)),
+      fftn_(WindowSize(sample_rate)) {
+    Eigen::ArrayXXd frames =
+        ParallelMelFrames(signal, sample_rate, num_threads);
+    num_frames_ = frames.cols();
+
+    /***************************************************************
+        Compensated running totals
+    ***************************************************************/
+    // TwoSum: sum + frame is rounded into the new sum and its rounding error
+    // is carried exactly into error_.
+    sum_.resize(frames.rows(), num_frames_ + 1);
+    error_.resize(frames.rows(), num_frames_ + 1);
+    sum_.col(0).setZero();
+    error_.col(0).setZero();
+    for (int i = 0; i < num_frames_; i++) {
+        Eigen::ArrayXd total = sum_.col(i) + frames.col(i);
+        Eigen::ArrayXd frame_part = total - sum_.col(i);
+        Eigen::ArrayXd rounding = (sum_.col(i) - (total - frame_part)) +
+                                  (frames.col(i) - frame_part);
+        sum_.col(i + 1) = total;
+        error_.col(i + 1) = error_.col(i) + rounding;
+    }
+
+    /***************************************************************
+        Peak amplitude of each frame
+    ***************************************************************/
+    // Frames overlap and cover their window exactly, so the peak of a window
+    // is the largest peak of its frames.
+    frame_peaks_.resize(num_frames_);
+    for (int i = 0; i < num_frames_; i++) {
+        int start = i * hop_;
+        int end = std::min<int>(start + fftn_, signal_.size());
+        frame_peaks_(i) = signal_.segment(start, end - start).abs().maxCoeff();
+    }
+}
+
+std::pair<int, int> RecordingScanner::Span(int first_frame,
+                                           int num_frames) const {
+    int start = first_frame * hop_;
+    int end = std::min<int>((first_frame + num_frames - 1) * hop_ + fftn_,
+                            signal_.size());
+    return {start, end};
+}
+
+double RecordingScanner::MaxAmplitude(int first, int last) {
+    if (first < first_ || last < last_) {
+        peak_frames_.clear();
+        first_ = last_ = first;
+    }
+
+    for (; last_ < last; last_++) {
+        while (!peak_frames_.empty() &&
+               frame_peaks_(peak_frames_.back()) <= frame_peaks_(last_)) {
+            peak_frames_.pop_back();
+        }
+        peak_frames_.push_back(last_);
+    }
+    while (peak_frames_.front() < first) {
+        peak_frames_.pop_front();
+    }
+    first_ = first;
+
+    return frame_peaks_(peak_frames_.front());
+}
+
+const Eigen::ArrayXXd& RecordingScanner::Extract(int first_frame,
+                                                 int num_frames) {
+    assert(num_frames >= kNumPeriods);
+    assert(first_frame >= 0 && first_frame + num_frames <= num_frames_);
+
+    // Same normalization as Extract on the window alone. Power scales with
+    // the square of amplitude, so it is applied to each period's mean.
+    double max_amplitude = MaxAmplitude(first_frame, first_frame + num_frames);
+    double scale = max_amplitude > 0 ? max_amplitude * max_amplitude : 1;
+
+    // Same period boundaries as ExtractFeature.
+    double breaks = static_cast<double>(num_frames) / kNumPeriods;
+
+    pooled_.resize(sum_.rows(), kNumPeriods);
+    for (int i = 0; i < kNumPeriods; i++) {
+        int low_i = first_frame + std::round(i * breaks);
+        int high_i = first_frame + std::round((i + 1) * breaks);
+        pooled_.col(i) = ((sum_.col(high_i) - sum_.col(low_i)) +
+                          (error_.col(high_i) - error_.col(low_i))) /
+                         ((high_i - low_i) * scale);
+    }
+
+    simd::Log10(pooled_.data(), pooled_.size(), kEpsilon, fast_log_);
+    return pooled_;
+}
@@ -0,0 +1,506 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PROJ748_X86 1
+#endif
+
+namespace {
+constexpr double kSqrt2 = 1.41421356237309505;
+constexpr double kLn2 = 0.693147180559945309;
+constexpr double kLog10E = 0.434294481903251828;
+
+// ln(m) = 2 atanh(t) with t = (m - 1) / (m + 1). Keeping m in
+// [1 / sqrt(2), sqrt(2)) bounds |t| by 0.1716, so the series to t^11 leaves
+// an error below 2 |t|^13 / 13 ~ 2e-11 in ln, or 1e-11 in log10.
+constexpr double kAtanhCoeffs[] = {1. / 11, 1. / 9, 1. / 7, 1. / 5, 1. / 3, 1};
+
+/***************************************************************
+    Portable kernels
+***************************************************************/
+void WindowFrameScalar(const double* window, const double* signal,
+                       double scale, double* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = window[i] * (signal[i] / scale);
+    }
+}
+
+void Abs2Scalar(const double* spectrum, double* out, int n) {
+    for (int i = 0; i < n; i++) {
+        double re = spectrum[2 * i];
+        double im = spectrum[2 * i + 1];
+        out[i] = re * re + im * im;
+    }
+}
+
+void ApplyFilterbankScalar(const BandedFilterbank& filters,
+                           const double* power, double* out) {
+    for (int f = 0; f < filters.num_filters(); f++) {
+        const double* w = filters.weights.data() + filters.offset[f];
+        const double* p = power + filters.first_bin[f];
+        int n = filters.offset[f + 1] - filters.offset[f];
+
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += w[i] * p[i];
+        }
+        out[f] = sum;
+    }
+}
+
+void FastLog10Scalar(double* x, int n, double epsilon) {
+    for (int i = 0; i < n; i++) {
+        x[i] = simd::FastLog10(x[i] + epsilon);
+    }
+}
+
+#ifdef PROJ748_X86
+/***************************************************************
+    SSE4.2
+***************************************************************/
+__attribute__((target("sse4.2"))) void WindowFrameSse42(
+    const double* window, const double* signal, double scale, double* out,
+    int n) {
+    const __m128d s = _mm_set1_pd(scale);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_div_pd(_mm_loadu_pd(signal + i), s);
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(window + i), x));
+    }
+    WindowFrameScalar(window + i, signal + i, scale, out + i, n - i);
+}
+
+__attribute__((target("sse4.2"))) void Abs2Sse42(const double* spectrum,
+                                                double* out, int n) {
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d a = _mm_loadu_pd(spectrum + 2 * i);      // c0
+        __m128d b = _mm_loadu_pd(spectrum + 2 * i + 2);  // c1
+        _mm_storeu_pd(out + i,
+                      _mm_hadd_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)));
+    }
+    Abs2Scalar(spectrum + 2 * i, out + i, n - i);
+}
+
+__attribute__((target("sse4.2"))) void ApplyFilterbankSse42(
+    const BandedFilterbank& filters, const double* power, double* out) {
+    for (int f = 0; f < filters.num_filters(); f++) {
+        const double* w = filters.weights.data() + filters.offset[f];
+        const double* p = power + filters.first_bin[f];
+        int n = filters.offset[f + 1] - filters.offset[f];
+
+        __m128d acc = _mm_setzero_pd();
+        int i = 0;
+        for (; i + 2 <= n; i += 2) {
+            acc = _mm_add_pd(
+                acc, _mm_mul_pd(_mm_loadu_pd(w + i), _mm_loadu_pd(p + i)));
+        }
+        double sum = _mm_cvtsd_f64(_mm_hadd_pd(acc, acc));
+        for (; i < n; i++) {
+            sum += w[i] * p[i];
+        }
+        out[f] = sum;
+    }
+}
+
+__attribute__((target("sse4.2"))) void FastLog10Sse42(double* x, int n,
+                                                     double epsilon) {
+    const __m128d eps = _mm_set1_pd(epsilon);
+    const __m128d one = _mm_set1_pd(1);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d sqrt2 = _mm_set1_pd(kSqrt2);
+    const __m128i mantissa_mask = _mm_set1_epi64x(0x000FFFFFFFFFFFFFll);
+    const __m128i one_bits = _mm_set1_epi64x(0x3FF0000000000000ll);
+    // 2^52 + 1023, to turn the biased exponent bits into a double.
+    const __m128i magic_bits = _mm_set1_epi64x(0x4330000000000000ll);
+    const __m128d magic = _mm_set1_pd(4503599627370496. + 1023);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_add_pd(_mm_loadu_pd(x + i), eps);
+        __m128i bits = _mm_castpd_si128(v);
+
+        __m128d e = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(
+                                   _mm_srli_epi64(bits, 52), magic_bits)),
+                               magic);
+        __m128d m = _mm_castsi128_pd(
+            _mm_or_si128(_mm_and_si128(bits, mantissa_mask), one_bits));
+
+        __m128d big = _mm_cmpge_pd(m, sqrt2);
+        m = _mm_blendv_pd(m, _mm_mul_pd(m, half), big);
+        e = _mm_add_pd(e, _mm_and_pd(big, one));
+
+        __m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+        __m128d t2 = _mm_mul_pd(t, t);
+        __m128d p = _mm_set1_pd(kAtanhCoeffs[0]);
+        for (int k = 1; k < 6; k++) {
+            p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(kAtanhCoeffs[k]));
+        }
+        __m128d ln_m = _mm_mul_pd(_mm_add_pd(t, t), p);
+        __m128d ln = _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(kLn2)), ln_m);
+        _mm_storeu_pd(x + i, _mm_mul_pd(ln, _mm_set1_pd(kLog10E)));
+    }
+    FastLog10Scalar(x + i, n - i, epsilon);
+}
+
+/***************************************************************
+    AVX2 and FMA
+***************************************************************/
+__attribute__((target("avx2,fma"))) double HorizontalSum(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma"))) void WindowFrameAvx2(
+    const double* window, const double* signal, double scale, double* out,
+    int n) {
+    const __m256d s = _mm256_set1_pd(scale);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_div_pd(_mm256_loadu_pd(signal + i), s);
+        __m256d w = _mm256_loadu_pd(window + i);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(w, x));
+    }
+    // The tail calls non-AVX code. GCC does not always clear the upper
+    // halves before it, which makes every later SSE instruction slow.
+    _mm256_zeroupper();
+    WindowFrameScalar(window + i, signal + i, scale, out + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void Abs2Avx2(const double* spectrum,
+                                                 double* out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(spectrum + 2 * i);      // c0, c1
+        __m256d b = _mm256_loadu_pd(spectrum + 2 * i + 4);  // c2, c3
+        // hadd gives |c0|^2, |c2|^2, |c1|^2, |c3|^2.
+        __m256d sums = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+        _mm256_storeu_pd(out + i, _mm256_permute4x64_pd(sums, 0xD8));
+    }
+    _mm256_zeroupper();
+    Abs2Scalar(spectrum + 2 * i, out + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void ApplyFilterbankAvx2(
+    const BandedFilterbank& filters, const double* power, double* out) {
+    for (int f = 0; f < filters.num_filters(); f++) {
+        const double* w = filters.weights.data() + filters.offset[f];
+        const double* p = power + filters.first_bin[f];
+        int n = filters.offset[f + 1] - filters.offset[f];
+
+        __m256d acc = _mm256_setzero_pd();
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc = _mm256_fmadd_pd(_mm256_loadu_pd(w + i),
+                                  _mm256_loadu_pd(p + i), acc);
+        }
+        double sum = HorizontalSum(acc);
+        for (; i < n; i++) {
+            sum += w[i] * p[i];
+        }
+        out[f] = sum;
+    }
+}
+
+__attribute__((target("avx2,fma"))) void FastLog10Avx2(double* x, int n,
+                                                      double epsilon) {
+    const __m256d eps = _mm256_set1_pd(epsilon);
+    const __m256d one = _mm256_set1_pd(1);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d sqrt2 = _mm256_set1_pd(kSqrt2);
+    const __m256i mantissa_mask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFll);
+    const __m256i one_bits = _mm256_set1_epi64x(0x3FF0000000000000ll);
+    // 2^52 + 1023, to turn the biased exponent bits into a double.
+    const __m256i magic_bits = _mm256_set1_epi64x(0x4330000000000000ll);
+    const __m256d magic = _mm256_set1_pd(4503599627370496. + 1023);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_add_pd(_mm256_loadu_pd(x + i), eps);
+        __m256i bits = _mm256_castpd_si256(v);
+
+        __m256d e = _mm256_sub_pd(
+            _mm256_castsi256_pd(
+                _mm256_or_si256(_mm256_srli_epi64(bits, 52), magic_bits)),
+            magic);
+        __m256d m = _mm256_castsi256_pd(
+            _mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), one_bits));
+
+        __m256d big = _mm256_cmp_pd(m, sqrt2, _CMP_GE_OQ);
+        m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), big);
+        e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+        __m256d t = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+        __m256d t2 = _mm256_mul_pd(t, t);
+        __m256d p = _mm256_set1_pd(kAtanhCoeffs[0]);
+        for (int k = 1; k < 6; k++) {
+            p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(kAtanhCoeffs[k]));
+        }
+        __m256d ln_m = _mm256_mul_pd(_mm256_add_pd(t, t), p);
+        __m256d ln = _mm256_fmadd_pd(e, _mm256_set1_pd(kLn2), ln_m);
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(ln, _mm256_set1_pd(kLog10E)));
+    }
+    _mm256_zeroupper();
+    FastLog10Scalar(x + i, n - i, epsilon);
+}
+
+/***************************************************************
+    AVX-512F
+***************************************************************/
+__attribute__((target("avx512f"))) __mmask8 TailMask(int remaining) {
+    return remaining >= 8 ? 0xFF : (1u << remaining) - 1;
+}
+
+__attribute__((target("avx512f"))) void WindowFrameAvx512(
+    const double* window, const double* signal, double scale, double* out,
+    int n) {
+    const __m512d s = _mm512_set1_pd(scale);
+    for (int i = 0; i < n; i += 8) {
+        __mmask8 m = TailMask(n - i);
+        __m512d x = _mm512_div_pd(_mm512_maskz_loadu_pd(m, signal + i), s);
+        _mm512_mask_storeu_pd(
+            out + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, window + i), x));
+    }
+}
+
+__attribute__((target("avx512f"))) void Abs2Avx512(const double* spectrum,
+                                                  double* out, int n) {
+    const __m512i even = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m512i odd = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d a = _mm512_loadu_pd(spectrum + 2 * i);
+        __m512d b = _mm512_loadu_pd(spectrum + 2 * i + 8);
+        __m512d re = _mm512_permutex2var_pd(a, even, b);
+        __m512d im = _mm512_permutex2var_pd(a, odd, b);
+        _mm512_storeu_pd(out + i,
+                         _mm512_add_pd(_mm512_mul_pd(re, re),
+                                       _mm512_mul_pd(im, im)));
+    }
+    _mm256_zeroupper();
+    Abs2Scalar(spectrum + 2 * i, out + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void ApplyFilterbankAvx512(
+    const BandedFilterbank& filters, const double* power, double* out) {
+    for (int f = 0; f < filters.num_filters(); f++) {
+        const double* w = filters.weights.data() + filters.offset[f];
+        const double* p = power + filters.first_bin[f];
+        int n = filters.offset[f + 1] - filters.offset[f];
+
+        __m512d acc = _mm512_setzero_pd();
+        for (int i = 0; i < n; i += 8) {
+            __mmask8 m = TailMask(n - i);
+            acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, w + i),
+                                  _mm512_maskz_loadu_pd(m, p + i), acc);
+        }
+        out[f] = _mm512_reduce_add_pd(acc);
+    }
+}
+
+__attribute__((target("avx512f"))) void FastLog10Avx512(double* x, int n,
+                                                       double epsilon) {
+    const __m512d eps = _mm512_set1_pd(epsilon);
+    const __m512d one = _mm512_set1_pd(1);
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d sqrt2 = _mm512_set1_pd(kSqrt2);
+
+    for (int i = 0; i < n; i += 8) {
+        __mmask8 mask = TailMask(n - i);
+        // Masked off lanes load 1 so they stay finite.
+        __m512d v = _mm512_add_pd(_mm512_mask_loadu_pd(one, mask, x + i), eps);
+
+        // v = 2^e * m with m in [1, 2).
+        __m512d e = _mm512_getexp_pd(v);
+        __m512d m = _mm512_getmant_pd(v, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+
+        __mmask8 big = _mm512_cmp_pd_mask(m, sqrt2, _CMP_GE_OQ);
+        m = _mm512_mask_mul_pd(m, big, m, half);
+        e = _mm512_mask_add_pd(e, big, e, one);
+
+        __m512d t = _mm512_div_pd(_mm512_sub_pd(m, one), _mm512_add_pd(m, one));
+        __m512d t2 = _mm512_mul_pd(t, t);
+        __m512d p = _mm512_set1_pd(kAtanhCoeffs[0]);
+        for (int k = 1; k < 6; k++) {
+            p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(kAtanhCoeffs[k]));
+        }
+        __m512d ln_m = _mm512_mul_pd(_mm512_add_pd(t, t), p);
+        __m512d ln = _mm512_fmadd_pd(e, _mm512_set1_pd(kLn2), ln_m);
+        _mm512_mask_storeu_pd(x + i, mask,
+                              _mm512_mul_pd(ln, _mm512_set1_pd(kLog10E)));
+    }
+}
+#endif
+
+struct Kernels {
+    void (*window_frame)(const double*, const double*, double, double*, int);
+    void (*abs2)(const double*, double*, int);
+    void (*apply_filterbank)(const BandedFilterbank&, const double*, double*);
+    void (*fast_log10)(double*, int, double);
+};
+
+const Kernels& ActiveKernels() {
+    static const Kernels kernels = [] {
+        switch (ActiveSimdLevel()) {
+#ifdef PROJ748_X86
+            case SimdLevel::kAvx512:
+                return Kernels{WindowFrameAvx512, Abs2Avx512,
+                               ApplyFilterbankAvx512, FastLog10Avx512};
+            case SimdLevel::kAvx2:
+                return Kernels{WindowFrameAvx2, Abs2Avx2, ApplyFilterbankAvx2,
+                               FastLog10Avx2};
+            case SimdLevel::kSse42:
+                return Kernels{WindowFrameSse42, Abs2Sse42,
+                               ApplyFilterbankSse42, FastLog10Sse42};
+#endif
+            default:
+                return Kernels{WindowFrameScalar, Abs2Scalar,
+                               ApplyFilterbankScalar, FastLog10Scalar};
+        }
+    }();
+    return kernels;
+}
+}  // namespace
+
+SimdLevel ActiveSimdLevel() {
+    static const SimdLevel level = [] {
+        SimdLevel best = SimdLevel::kScalar;
+#ifdef PROJ748_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            best = SimdLevel::kAvx512;
+        } else if (__builtin_cpu_supports("avx2") &&
+                   __builtin_cpu_supports("fma")) {
+            best = SimdLevel::kAvx2;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            best = SimdLevel::kSse42;
+        }
+#endif
+        if (const char* env = std::getenv("PROJ748_SIMD")) {
+            for (auto requested : {SimdLevel::kScalar, SimdLevel::kSse42,
+                                   SimdLevel::kAvx2, SimdLevel::kAvx512}) {
+                if (SimdLevelName(requested) == env) {
+                    best = std::min(best, requested);
+                }
+            }
+        }
+        return best;
+    }();
+    return level;
+}
+
+std::string SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::kScalar:
+            return "scalar";
+        case SimdLevel::kSse42:
+            return "sse4.2";
+        case SimdLevel::kAvx2:
+            return "avx2";
+        case SimdLevel::kAvx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+bool DefaultFastLog() {
+    const char* env = std::getenv("PROJ748_FAST_LOG");
+    return env && std::atoi(env) != 0;
+}
+
+BandedFilterbank BandedFilterbank::FromDense(const Eigen::ArrayXXd& filters) {
+    struct Arrays {
+        std::vector<int32_t> first_bin;
+        std::vector<int32_t> offset;
+        std::vector<double> weights;
+    };
+    auto arrays = std::make_shared<Arrays>();
+    arrays->offset.push_back(0);
+
+    for (int f = 0; f < filters.rows(); f++) {
+        int first = 0;
+        int last = -1;  // inclusive
+        for (int b = 0; b < filters.cols(); b++) {
+            if (filters(f, b) == 0) continue;
+            if (last < 0) first = b;
+            last = b;
+        }
+
+        arrays->first_bin.push_back(first);
+        for (int b = first; b <= last; b++) {
+            arrays->weights.push_back(filters(f, b));
+        }
+        arrays->offset.push_back(arrays->weights.size());
+    }
+
+    BandedFilterbank banded;
+    banded.num_bins = filters.cols();
+    banded.first_bin = arrays->first_bin;
+    banded.offset = arrays->offset;
+    banded.weights = arrays->weights;
+    banded.storage = std::move(arrays);
+    return banded;
+}
+
+namespace simd {
+
+void WindowFrame(const double* window, const double* signal, double scale,
+                 double* out, int n) {
+    ActiveKernels().window_frame(window, signal, scale, out, n);
+}
+
+void Abs2(const double* spectrum, double* out, int n) {
+    ActiveKernels().abs2(spectrum, out, n);
+}
+
+void ApplyFilterbank(const BandedFilterbank& filters, const double* power,
+                     double* out) {
+    ActiveKernels().apply_filterbank(filters, power, out);
+}
+
+void Log10(double* x, int n, double epsilon, bool fast) {
+    if (fast) {
+        ActiveKernels().fast_log10(x, n, epsilon);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        x[i] = std::log10(x[i] + epsilon);
+    }
+}
+
+double FastLog10(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+
+    // x = 2^e * m with m in [1, 2).
+    double e = static_cast<int>(bits >> 52) - 1023;
+    bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+    double m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    if (m >= kSqrt2) {
+        m *= 0.5;
+        e += 1;
+    }
+
+    double t = (m - 1) / (m + 1);
+    double t2 = t * t;
+    double p = kAtanhCoeffs[0];
+    for (int k = 1; k < 6; k++) {
+        p = p * t2 + kAtanhCoeffs[k];
+    }
+    return (e * kLn2 + 2 * t * p) * kLog10E;
+}
+
+}  // namespace simd
@@ -0,0 +1,136 @@
+#include "stats.hpp"
+
+#include <Eigen/Eigenvalues>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#include "fileio.hpp"
+
+namespace fs = std::filesystem;
+
+FeatureStats::FeatureStats(int dims)
+    : moments_(Eigen::MatrixXd::Zero(dims + 1, dims + 1)) {}
+
+static Eigen::MatrixXd Augment(const Eigen::MatrixXd& features) {
+    Eigen::MatrixXd augmented(features.rows(), features.cols() + 1);
+    augmented.col(0).setOnes();
+    augmented.rightCols(features.cols()) = features;
+    return augmented;
+}
+
+void FeatureStats::Add(const Eigen::MatrixXd& features) {
+    if (features.cols() != dims()) {
+        throw std::invalid_argument(
+            "Feature has " + std::to_string(features.cols()) +
+            " dimensions but statistics have " + std::to_string(dims()) + ".");
+    }
+    moments_.selfadjointView<Eigen::Lower>().rankUpdate(
+        Augment(features).transpose(), 1.);
+}
+
+void FeatureStats::Remove(const Eigen::MatrixXd& features) {
+    if (features.cols() != dims()) {
+        throw std::invalid_argument(
+            "Feature has " + std::to_string(features.cols()) +
+            " dimensions but statistics have " + std::to_string(dims()) + ".");
+    }
+    if (features.rows() > count()) {
+        throw std::runtime_error("Removed more features than were added.");
+    }
+    moments_.selfadjointView<Eigen::Lower>().rankUpdate(
+        Augment(features).transpose(), -1.);
+}
+
+void FeatureStats::Merge(const FeatureStats& other) {
+    if (other.dims() != dims()) {
+        throw std::invalid_argument(
+            "Cannot merge statistics with " + std::to_string(other.dims()) +
+            " dimensions into " + std::to_string(dims()) + ".");
+    }
+    moments_.triangularView<Eigen::Lower>() += other.moments_;
+}
+
+int FeatureStats::dims() const {
+    return moments_.rows() - 1;
+}
+
+double FeatureStats::count() const {
+    return moments_(0, 0);
+}
+
+Eigen::VectorXd FeatureStats::Mean() const {
+    return moments_.col(0).tail(dims()) / count();
+}
+
+Eigen::MatrixXd FeatureStats::Covariance() const {
+    Eigen::VectorXd mean = Mean();
+    Eigen::MatrixXd covar =
+        moments_.bottomRightCorner(dims(), dims())
+            .selfadjointView<Eigen::Lower>();
+    covar /= count();  // normalization
+    covar -= mean * mean.transpose();
+    return covar;
+}
+
+void FeatureStats::Save(fs::path filename) const {
+    Eigen::MatrixXd full = moments_.selfadjointView<Eigen::Lower>();
+    SaveMatrix(filename, full, Encoding::kFloat64);
+}
+
+FeatureStats FeatureStats::Load(fs::path filename) {
+    Eigen::MatrixXd moments = LoadMatrix(filename);
+    if (moments.rows() == 0 || moments.rows() != moments.cols()) {
+        throw std::runtime_error(filename.string() +
+                                 " is not a feature statistics file.");
+    }
+
+    FeatureStats stats(moments.rows() - 1);
+    stats.moments_ = moments;
+    return stats;
+}
+
+std::vector<fs::path> SaveBasis(fs::path stem, const FeatureStats& stats,
+                                Encoding encoding) {
+    if (stats.count() < 1) {
+        throw std::invalid_argument("No features to compute a basis from.");
+    }
+
+    Eigen::VectorXd mean = stats.Mean();
+    Eigen::MatrixXd covar = stats.Covariance();
+
+    // Assert symmetric and has intended dimensions
+    assert(covar.cols() == covar.rows());
+    assert(covar.cols() == mean.size());
+    assert((covar - covar.transpose())
+               .isApprox(Eigen::MatrixXd::Zero(covar.rows(), covar.cols())));
+
+    /***************************************************************
+        Eigenvalue decomposition
+    ***************************************************************/
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es;
+    es.compute(covar);
+
+    /***************************************************************
+        Save output
+    ***************************************************************/
+    std::vector<fs::path> written;
+
+    fs::path scree_file = fs::path(stem).replace_extension(".scree");
+    SaveCSV(scree_file, es.eigenvalues());
+    written.push_back(scree_file);
+
+    fs::path basis_file = fs::path(stem).replace_extension(".basis");
+    SaveMatrix(basis_file, es.eigenvectors(), encoding);
+    written.push_back(basis_file);
+
+    fs::path mean_file = fs::path(stem).replace_extension(".mean");
+    SaveMatrix(mean_file, mean, encoding);
+    written.push_back(mean_file);
+
+    fs::path stats_file = fs::path(stem).replace_extension(".stats");
+    stats.Save(stats_file);
+    written.push_back(stats_file);
+
+    return written;
+}
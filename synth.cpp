@@ -0,0 +1,149 @@
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio.hpp"
+#include "augment.hpp"
+#include "fileio.hpp"
+#include "pipeline.hpp"
+#include "sndfile.hh"
+
+namespace fs = std::filesystem;
+
+struct Args {
+    std::vector<fs::path> wav_files;
+    fs::path out_dir;
+    long count;
+    double seconds = 0;
+    int sample_rate = 0;
+    uint64_t seed = 748;
+
+    const std::string USAGE =
+        "Usage: ./synth <wavs.txt> <partition> <count> <seconds?> "
+        "<sample-rate?> <seed?>";
+
+    Args(int argc, char* argv[]) {
+        if (argc < 4 || argc > 7) {
+            std::cerr << USAGE << std::endl;
+            exit(2);
+        }
+
+        wav_files = ReadFileListing(argv[1]);
+        out_dir = argv[2];
+        count = std::stol(argv[3]);
+        if (argc >= 5) seconds = std::stod(argv[4]);
+        if (argc >= 6) sample_rate = std::stoi(argv[5]);
+        if (argc == 7) seed = std::stoull(argv[6]);
+
+        if (wav_files.empty() || count <= 0 || seconds < 0 ||
+            sample_rate < 0) {
+            std::cerr << USAGE << std::endl;
+            exit(2);
+        }
+    }
+};
+
+// Crops the middle of the clip, or centres it in silence, to exactly n
+// samples.
+Eigen::ArrayXd FitLength(const Eigen::ArrayXd& clip, Eigen::Index n) {
+    if (clip.size() >= n) {
+        return clip.segment((clip.size() - n) / 2, n);
+    }
+    Eigen::ArrayXd out = Eigen::ArrayXd::Zero(n);
+    out.segment((n - clip.size()) / 2, clip.size()) = clip;
+    return out;
+}
+
+// Writes a deterministic corpus of `count` labelled clips in the layout made
+// by partition.py, for benchmarking at scales the recordings cannot reach.
+//
+// Clip k is source clip k % sources, resampled, perturbed by the augmenter
+// with clip id k, then cropped or padded to the requested duration. It is
+// named <digit>_synth_<k>.wav after its source's digit and every fifth clip
+// goes to test_data. The output depends only on the arguments, not on the
+// number of threads.
+int main(int argc, char* argv[]) {
+    Args args(argc, argv);
+
+    const fs::path train_dir = args.out_dir / "train_data";
+    const fs::path test_dir = args.out_dir / "test_data";
+    fs::create_directories(train_dir);
+    fs::create_directories(test_dir);
+
+    const Augmenter augmenter([&] {
+        AugmentOptions options;
+        options.seed = args.seed;
+        return options;
+    }());
+
+    std::atomic<long> next = 0;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto work = [&] {
+        while (true) {
+            long k = next++;
+            if (k >= args.count) return;
+
+            try {
+                const fs::path& source =
+                    args.wav_files[k % args.wav_files.size()];
+                AudioFile aud(source.string());
+                int rate =
+                    args.sample_rate ? args.sample_rate : aud.sample_rate;
+
+                Eigen::ArrayXd clip = aud.data;
+                if (rate != aud.sample_rate) {
+                    clip = ChangeSpeed(
+                        clip, static_cast<double>(aud.sample_rate) / rate);
+                }
+                clip = augmenter.Apply(clip, rate, k, 0);
+                if (args.seconds > 0) {
+                    clip = FitLength(clip, std::lround(args.seconds * rate));
+                }
+
+                // Leave headroom for the 16-bit conversion.
+                double peak = clip.abs().maxCoeff();
+                if (peak > 0) clip *= 0.9 / peak;
+
+                std::string name = source.stem().string().substr(0, 1) +
+                                   "_synth_" + std::to_string(k) + ".wav";
+                fs::path out = (k % 5 == 4 ? test_dir : train_dir) / name;
+
+                SndfileHandle file(out.string(), SFM_WRITE,
+                                   SF_FORMAT_WAV | SF_FORMAT_PCM_16, 1, rate);
+                if (file.error() ||
+                    file.write(clip.data(), clip.size()) != clip.size()) {
+                    throw std::runtime_error("Failed to write " +
+                                             out.string());
+                }
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next = args.count;
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::max(1, DefaultThreadCount()); t++) {
+        threads.emplace_back(work);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (error) std::rethrow_exception(error);
+
+    std::cout << train_dir << std::endl << test_dir << std::endl;
+    return 0;
+}